@@ -126,19 +126,7 @@ static void
 timer_interrupt (struct intr_frame *args UNUSED) {
 	ticks++;
 	thread_tick ();	// update the cpu usage for running process
-
-	/* Code to add:
-			check sleep list and the global tick.
-			find any threads to wake up,
-			move them to the ready list if necessary.
-			Update the global tick.
-	*/
-	// global tick인 min_tick이 현재 시간보다 작거나 같으면 깨울 thread 존재
-	
-	// if (ticks >= thread_get_mintick()){
-		thread_wakeup(ticks);
-		thread_save_mintick();
-	// }
+	thread_wakeup (ticks);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -105,7 +105,6 @@ struct list {
 		- offsetof (STRUCT, MEMBER.next)))
 
 #define elem2thread(ELEM)	(list_entry(ELEM,struct thread, elem));	
-#define delem2thread(DELEM)	(list_entry(DELEM,struct thread, d_elem));	
 
 void list_init (struct list *);
 
@@ -0,0 +1,29 @@
+#ifndef __LIB_SCHED_STATS_H
+#define __LIB_SCHED_STATS_H
+
+#include <stdint.h>
+
+/* Number of buckets in a wakeup latency histogram.  Bucket N
+   counts wakeups that waited from 2**N up to 2**(N+1) TSC cycles
+   to run; the last bucket also counts all longer waits. */
+#define SCHED_LATENCY_BUCKETS 32
+
+/* Scheduling counters, of one thread or summed over all threads.
+   Times are in TSC cycles. */
+struct sched_counts {
+	uint64_t wait;                      /* Time ready but not running. */
+	uint64_t voluntary;                 /* Switches away on block or exit. */
+	uint64_t involuntary;               /* Switches away while still ready. */
+	uint64_t wakeups;                   /* Wakeups, the sum of LATENCY. */
+	uint32_t latency[SCHED_LATENCY_BUCKETS]; /* Wakeup-to-run latency. */
+};
+
+/* One record returned by the sched_stats() system call. */
+struct sched_stats {
+	int tid;                            /* Thread, or 0 for the total. */
+	char name[16];                      /* Thread name. */
+	int priority;                       /* Effective priority. */
+	struct sched_counts counts;
+};
+
+#endif /* lib/sched-stats.h */
@@ -36,6 +36,8 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	SYS_SCHED_STATS,            /* Read scheduling statistics. */
 };
 
 #endif /* lib/syscall-nr.h */
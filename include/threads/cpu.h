@@ -0,0 +1,54 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Maximum number of CPUs the kernel keeps state for. */
+#define CPU_MAX 8
+
+/* Run queue of one CPU: threads in THREAD_READY state that will
+   run on it.  There is one FIFO queue per priority level, and
+   bit P of BITMAP is set iff QUEUES[P] is nonempty, so enqueue,
+   dequeue and finding the highest ready priority are all
+   constant time. */
+struct runqueue {
+	struct spinlock lock;               /* Protects the members below. */
+	struct list queues[PRI_MAX + 1];    /* Ready threads, by priority. */
+	uint64_t bitmap;                    /* Nonempty queues. */
+	int cnt;                            /* # of threads in QUEUES. */
+};
+
+/* Per-CPU state.
+
+   Each CPU only ever touches its own struct cpu with interrupts
+   disabled, except for the run queue, which other CPUs may add
+   threads to under RQ.LOCK. */
+struct cpu {
+	int id;                             /* Index into cpus[]. */
+	bool online;                        /* Scheduling threads? */
+
+	struct thread *curr;                /* Running thread. */
+	struct thread *idle;                /* This CPU's idle thread. */
+	unsigned slice_ticks;               /* # of timer ticks since last yield. */
+	struct runqueue rq;                 /* Threads waiting to run here. */
+	unsigned long long switch_cnt;      /* # of context switches. */
+	struct thread *fpu_owner;           /* Thread whose state is in the FPU. */
+	struct sched_counts sched;          /* Statistics of threads run here. */
+
+	bool in_external_intr;              /* Processing an external interrupt? */
+	bool yield_on_return;               /* Yield on interrupt return? */
+};
+
+/* Only cpus[0], the bootstrap processor, is used: the other
+   processors are never started, so both counts are always 1. */
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;                     /* # of CPUs in cpus[]. */
+extern int cpu_online_cnt;              /* # of CPUs scheduling threads. */
+
+struct cpu *this_cpu (void);
+
+#endif /* threads/cpu.h */
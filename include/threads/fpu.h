@@ -0,0 +1,18 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+/* Size of the FXSAVE area holding x87, MMX and SSE state. */
+#define FPU_STATE_SIZE 512
+
+void fpu_init (void);
+bool fpu_trap (void);
+void fpu_switch_out (struct thread *);
+void fpu_save (void);
+bool fpu_copy (struct thread *dst, struct thread *src);
+void fpu_release (struct thread *);
+
+#endif /* threads/fpu.h */
@@ -0,0 +1,33 @@
+#ifndef THREADS_MEMPROF_H
+#define THREADS_MEMPROF_H
+
+#include <stddef.h>
+
+/* Kernel memory allocation profiler.  See memprof.c.
+
+   Built only with KMEM_PROFILE defined (`make KMEM_PROFILE=1');
+   otherwise the hooks compile to nothing. */
+
+/* Number of call sites in the default report. */
+#define MEMPROF_TOP 20
+
+/* Kinds of allocation. */
+enum memprof_kind {
+	MEMPROF_MALLOC,             /* malloc(), calloc(), realloc(). */
+	MEMPROF_PAGE                /* palloc_get_page(), palloc_get_multiple(). */
+};
+
+#ifdef KMEM_PROFILE
+void memprof_init (void);
+void memprof_alloc (const void *, size_t size, size_t class_size,
+		enum memprof_kind, const void *site);
+void memprof_free (const void *);
+void memprof_print (size_t top_cnt);
+#else
+#define memprof_init() ((void) 0)
+#define memprof_alloc(P, SIZE, CLASS_SIZE, KIND, SITE) ((void) 0)
+#define memprof_free(P) ((void) 0)
+#define memprof_print(TOP_CNT) ((void) 0)
+#endif
+
+#endif /* threads/memprof.h */
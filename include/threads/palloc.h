@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -19,5 +20,13 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_extend (void *, size_t page_cnt, size_t new_cnt);
+size_t palloc_free_cnt (enum palloc_flags);
+size_t palloc_largest_free (enum palloc_flags);
+void palloc_set_owner (void *, size_t page_cnt, void *owner);
+void *palloc_get_owner (const void *);
+void palloc_drain_caches (void);
+void palloc_zero_start (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -41,5 +41,13 @@
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* 1=PDE maps a 2 MB page. */
+
+/* A PDE with PTE_PS set maps a "huge" page of HUGE_PGSIZE bytes
+   directly, with no page table below it.  PTE_ADDR() still gives
+   its physical address, and PTE_A and PTE_D mean the same. */
+#define HUGE_PGSIZE (1UL << PDXSHIFT)    /* Bytes in a huge page. */
+#define HUGE_PGMASK (HUGE_PGSIZE - 1)    /* Offset bits of a huge page. */
+#define HUGE_PGCNT (HUGE_PGSIZE / PGSIZE) /* Pages in a huge page. */
 
 #endif /* threads/pte.h */
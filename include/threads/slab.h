@@ -0,0 +1,23 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object cache.  See slab.c. */
+struct kmem_cache;
+
+/* Constructor, run on each object when its slab is created. */
+typedef void kmem_ctor_func (void *obj);
+
+/* Largest object a cache can hold. */
+#define KMEM_MAX_SIZE 1024
+
+void kmem_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		size_t align, kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+size_t kmem_reclaim (void);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
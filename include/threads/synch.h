@@ -1,8 +1,10 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include "threads/interrupt.h"
 
 /* A counting semaphore. */
 struct semaphore {
@@ -16,10 +18,19 @@ bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
-/* Lock. */
+/* Lock.
+
+   Threads waiting for a lock donate their priority to its
+   holder.  DONORS keeps the waiters ordered by priority, and each
+   thread keeps the locks it holds in a heap ordered by PRIORITY,
+   so a thread's effective priority is the greater of its own and
+   that of the top lock in its heap. */
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct heap donors;         /* Waiting threads, by priority. */
+	int priority;               /* Highest priority in DONORS. */
+	struct heap_elem elem;      /* Element in holder's held_locks. */
 };
 
 void lock_init (struct lock *);
@@ -27,6 +38,67 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+bool lock_priority_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+
+/* Adaptive lock.  Like a lock, but for critical sections only a
+   few hundred cycles long: a thread that finds it held first
+   spins while the holder is running on another CPU, or on a
+   uniprocessor yields once to let the holder finish, and only
+   then blocks, with priority donation, like lock_acquire(). */
+struct adaptive_lock {
+	struct lock lock;           /* Underlying lock. */
+	unsigned long long spin_cnt;   /* # of acquires won by spinning. */
+	unsigned long long yield_cnt;  /* # of acquires won by yielding. */
+	unsigned long long block_cnt;  /* # of acquires that blocked. */
+};
+
+void adaptive_lock_init (struct adaptive_lock *);
+void adaptive_lock_acquire (struct adaptive_lock *);
+bool adaptive_lock_try_acquire (struct adaptive_lock *);
+void adaptive_lock_release (struct adaptive_lock *);
+bool adaptive_lock_held_by_current_thread (const struct adaptive_lock *);
+
+/* Reader-writer lock.  Any number of threads may hold it
+   shared, or a single thread may hold it exclusive.  Writers are
+   preferred: once a writer is waiting, new readers queue behind
+   it, so a steady stream of readers cannot starve writers.  A
+   thread that blocks donates its priority to every current
+   holder. */
+struct rwlock {
+	int readers;                /* # of threads holding it shared. */
+	struct thread *writer;      /* Thread holding it exclusive. */
+	struct list holders;        /* struct rwlock_hold of each holder. */
+	struct list read_waiters;   /* Threads waiting to acquire shared. */
+	struct list write_waiters;  /* Threads waiting to acquire exclusive. */
+	struct heap donors;         /* All waiting threads, by priority. */
+	int priority;               /* Highest priority in DONORS. */
+};
+
+/* A thread's hold on a reader-writer lock.  Each thread has
+   RWLOCK_HOLD_MAX of these, so it can find the waiters it
+   inherits priority from.
+
+   A thread may hold at most RWLOCK_HOLD_MAX reader-writer locks
+   at once; acquiring one more fails an assertion.  The deepest
+   nesting in the kernel is three: a system call holds
+   filesys_lock, a directory operation takes the directory's lock
+   under it, and dir_remove() takes the removed inode's rwlock
+   under that. */
+#define RWLOCK_HOLD_MAX 3
+struct rwlock_hold {
+	struct rwlock *lock;        /* Lock held, or NULL if free. */
+	struct thread *thread;      /* Holding thread. */
+	struct list_elem elem;      /* Element in LOCK's holders list. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_shared (struct rwlock *);
+void rwlock_acquire_exclusive (struct rwlock *);
+void rwlock_release_shared (struct rwlock *);
+void rwlock_release_exclusive (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+int rwlock_donated_priority (const struct thread *);
 
 /* Condition variable. */
 struct condition {
@@ -37,8 +109,24 @@ void cond_init (struct condition *);
 void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
-void donate_priority(void);
 bool cmp_cond_waiters(const struct list_elem *a, const struct list_elem *b, void *aux);
+
+/* Spinlock, for data touched by more than one CPU at a time,
+   such as the per-CPU run queues.  Acquiring a spinlock also
+   disables interrupts on the local CPU, so it must only be held
+   for a few instructions and never across thread_block(). */
+struct spinlock {
+	volatile int locked;        /* Nonzero while held. */
+	struct cpu *cpu;            /* CPU holding the lock. */
+	enum intr_level old_level;  /* Interrupt level to restore. */
+};
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -3,8 +3,10 @@
 
 #include <debug.h>
 #include <list.h>
+#include <sched-stats.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
+#include "threads/fixed-point.h"
 #include "synch.h"
 #ifdef VM
 #include "vm/vm.h"
@@ -33,6 +35,8 @@ typedef int tid_t;
 #define FDT_PAGES 3
 #define FDCOUNT_LIMIT FDT_PAGES *(1<<9)
 
+struct cpu;
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -97,13 +101,24 @@ struct thread {
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
 	int64_t wakeup_tick;
-	int priority_origin;
-	struct list donation;
+	int priority_origin;                /* Priority before donation. */
+	struct heap held_locks;             /* Locks held, by donated priority. */
 	struct lock * wait_on_lock;
+	struct rwlock *wait_on_rwlock;      /* Reader-writer lock we wait for. */
+	struct rwlock_hold rw_holds[RWLOCK_HOLD_MAX]; /* Reader-writer locks held. */
+	int nice;                           /* Niceness, for the 4.4BSD scheduler. */
+	fixed_t recent_cpu;                 /* Recent CPU time, for the 4.4BSD scheduler. */
+	struct list_elem all_elem;          /* List element for all threads list. */
+	struct cpu *cpu;                    /* CPU running or about to run us. */
+	struct fpu_state *fpu;              /* Saved FPU state, if ever used. */
+	struct cpu *fpu_cpu;                /* CPU that last loaded FPU. */
+	uint64_t ready_tsc;                 /* TSC when last made ready. */
+	bool woken;                         /* Made ready by a wakeup? */
+	struct sched_counts sched;          /* Scheduling statistics. */
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
-	struct list_elem d_elem;
+	struct heap_elem donor_elem;        /* Element in a lock's donors. */
 
 	struct semaphore wait_sema;
 	struct semaphore exec_sema;
@@ -147,6 +162,8 @@ void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+int thread_sched_stats (struct sched_stats *, int cnt);
+void thread_print_sched_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -163,6 +180,9 @@ void thread_yield (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *, int);
+bool thread_refresh_priority (struct thread *);
+void thread_preempt (void);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -175,8 +195,6 @@ void do_iret (struct intr_frame *tf);
 /////// added /////
 void thread_sleep(int64_t ticks);
 void thread_wakeup(int64_t ticks);
-void thread_save_mintick();
-int64_t thread_get_mintick();
 bool less_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 struct thread* get_current_child(tid_t tid);
 #endif /* threads/thread.h */
@@ -1,6 +1,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include "threads/synch.h"
+
 void syscall_init (void);
-struct lock filesys_lock;
+
+/* Taken shared around file reads, and exclusive around file
+   writes, which read, modify, and write back partial sectors,
+   and around changes to the file system namespace. */
+extern struct rwlock filesys_lock;
 #endif /* userprog/syscall.h */
@@ -1,13 +1,25 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
 
+/* No swap slot. */
+#define SWAP_NONE ((size_t) -1)
+
 struct anon_page {
+	/* Swap slot that holds the page's contents, or SWAP_NONE.  A
+	 * page keeps its slot after it is swapped back in, for as long
+	 * as it stays clean, so that it can be evicted again without
+	 * being written. */
+	size_t slot;
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_share_slot (struct page *dst, struct page *src);
+void anon_forget_slot (struct page *page);
+void swap_print_stats (void);
 
 #endif
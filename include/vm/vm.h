@@ -1,6 +1,9 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -46,6 +49,9 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct thread *owner;  /* Thread whose address space holds VA. */
+	bool writable;         /* May the user write to VA? */
+	struct list_elem share_elem; /* Element in FRAME's PAGES. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -59,10 +65,19 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame"
+ *
+ * After fork() a frame may be shared copy-on-write by the pages of
+ * several processes, all mapped read-only.  PAGES lists them and
+ * PAGE_CNT, the frame's reference count, counts them; PAGE is one
+ * of them. */
 struct frame {
 	void *kva;
 	struct page *page;
+	struct list_elem elem;  /* Element in the frame table. */
+	struct list pages;      /* Pages mapped to this frame. */
+	unsigned page_cnt;      /* Number of PAGES. */
+	unsigned pin_cnt;       /* Exempt from eviction while nonzero. */
 };
 
 /* The function table for page operations.
@@ -81,12 +96,38 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* A sequence of faults that scans a region of lazily loaded pages
+ * from low to high addresses. */
+struct spt_stream {
+	uint64_t next_va;      /* Where the next fault should land. */
+	unsigned window;       /* Pages the last fault loaded, or 0. */
+};
+
+/* Streams tracked per address space. */
+#define SPT_STREAMS 4
+
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ *
+ * A radix tree laid out like the x86-64 page table: three levels
+ * of 512-entry interior nodes indexed by the PML4, PDPE, and PDX
+ * bits of a user virtual address, and 512-entry leaves indexed
+ * by its PTX bits that point to the `struct page's.  Each node is
+ * one page.  A lookup is four loads, or one when it hits the same
+ * 2 MB leaf as the previous lookup, and iterating over a range
+ * skips empty subtrees whole. */
 struct supplemental_page_table {
+	void **root;           /* Top-level node, or NULL if empty. */
+	uint64_t hint_va;      /* Base of the 2 MB region HINT maps. */
+	void **hint;           /* Leaf of the last lookup, or NULL. */
+	size_t node_cnt;       /* Number of nodes, for statistics. */
+	struct spt_stream streams[SPT_STREAMS]; /* For read-ahead. */
+	unsigned stream_next;  /* Stream to replace next. */
 };
 
+/* Called by spt_for_each() for each page in a range.  It may
+ * remove the page from the table. */
+typedef void spt_page_func (struct page *, void *aux);
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -96,8 +137,11 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+void spt_for_each (struct supplemental_page_table *spt, void *start,
+		void *end, spt_page_func *func, void *aux);
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
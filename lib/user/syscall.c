@@ -194,3 +194,8 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+sched_stats (struct sched_stats *stats, int cnt) {
+	return syscall2 (SYS_SCHED_STATS, stats, cnt);
+}
@@ -0,0 +1,115 @@
+/* Puts several hundred threads to sleep at once, with wakeup
+   times spread over a few hundred ticks so that the sleep queue
+   has to keep many sleepers on several levels at the same time.
+   Verifies that no thread wakes up before its requested tick.
+
+   Also compares how much work the main thread gets done per tick
+   with and without all those sleepers pending, as a measure of
+   the cost the sleepers add to the timer interrupt handler. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 400         /* Number of sleeping threads. */
+#define SLEEP_SPREAD 300        /* Wakeup times span this many ticks. */
+#define SPIN_TICKS 50           /* Length of each measurement. */
+
+/* Information about the test. */
+struct stress_test
+  {
+    int64_t start;              /* Wakeup times are relative to this. */
+    int asleep_cnt;             /* # of threads about to sleep. */
+    int early_cnt;              /* # of threads that woke up early. */
+    struct semaphore done;      /* Upped by each thread when done. */
+  };
+
+static struct stress_test test;
+
+static void sleeper (void *);
+static long long spin (int64_t tick_cnt);
+
+void
+test_alarm_stress (void) 
+{
+  long long idle_loops, busy_loops;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep at once.", SLEEPER_CNT);
+
+  idle_loops = spin (SPIN_TICKS);
+
+  test.start = timer_ticks () + 2 * SPIN_TICKS;
+  test.asleep_cnt = 0;
+  test.early_cnt = 0;
+  sema_init (&test.done, 0);
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper,
+                         (void *) (intptr_t) i) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+
+  /* Let every thread go to sleep, then measure with all of them
+     pending. */
+  while (test.asleep_cnt < SLEEPER_CNT)
+    timer_sleep (1);
+  busy_loops = spin (SPIN_TICKS);
+  msg ("timer interrupt: %lld%% of idle loops per tick with sleepers pending",
+       idle_loops > 0 ? busy_loops * 100 / idle_loops : 0);
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&test.done);
+
+  if (test.early_cnt != 0)
+    fail ("%d threads woke up before their wakeup time", test.early_cnt);
+  msg ("All %d threads woke up no earlier than requested.", SLEEPER_CNT);
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *idx_) 
+{
+  int idx = (intptr_t) idx_;
+  int64_t wakeup = test.start + (idx * 7919) % SLEEP_SPREAD;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  test.asleep_cnt++;
+  intr_set_level (old_level);
+
+  timer_sleep (wakeup - timer_ticks ());
+
+  old_level = intr_disable ();
+  if (timer_ticks () < wakeup)
+    test.early_cnt++;
+  intr_set_level (old_level);
+
+  sema_up (&test.done);
+}
+
+/* Busy-waits for TICK_CNT timer ticks, starting at a tick
+   boundary, and returns the number of loop iterations done. */
+static long long
+spin (int64_t tick_cnt) 
+{
+  int64_t start = timer_ticks ();
+  long long loops = 0;
+
+  while (timer_ticks () == start)
+    continue;
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < tick_cnt)
+    loops++;
+  return loops;
+}
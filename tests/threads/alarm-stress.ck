@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(alarm-stress\) timer interrupt: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(alarm-stress) begin
+(alarm-stress) Creating 400 threads to sleep at once.
+(alarm-stress) All 400 threads woke up no earlier than requested.
+(alarm-stress) end
+EOF
+pass;
@@ -0,0 +1,170 @@
+/* Has several threads hammer a short critical section, first
+   protected by a lock and then by an adaptive lock, and checks
+   that both keep the shared counter consistent.
+
+   Also reports the number of context switches each run took.
+   Threads that find the adaptive lock busy spin or yield to the
+   holder instead of blocking, so that run should need fewer.
+
+   Then has a waiter find the adaptive lock held by a thread that
+   is ready but not running, as if it had been preempted inside
+   its critical section, and checks that the waiter yields to the
+   holder and takes the lock after it instead of blocking. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4            /* Number of contending threads. */
+#define ITER_CNT 2000           /* Critical sections per thread. */
+#define CS_LENGTH 200           /* Loop iterations inside each one. */
+#define HANDOFF_CNT 10          /* Number of handoffs to a waiter. */
+
+/* Information about the test. */
+struct lock_test
+  {
+    bool adaptive;              /* Use adaptive_lock or lock? */
+    struct lock lock;
+    struct adaptive_lock adaptive_lock;
+    int counter;                /* Protected by the lock in use. */
+    struct semaphore done;      /* Upped by each thread when done. */
+  };
+
+static struct lock_test test;
+
+static void contender (void *);
+static void waiter (void *);
+static unsigned long long run (bool adaptive);
+static void handoff (void);
+static unsigned long long switch_cnt (void);
+
+void
+test_lock_adaptive (void) 
+{
+  unsigned long long plain, adaptive;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  plain = run (false);
+  msg ("lock: counter is %d.", test.counter);
+  adaptive = run (true);
+  msg ("adaptive lock: counter is %d.", test.counter);
+
+  msg ("context switches: %llu with lock, %llu with adaptive lock",
+       plain, adaptive);
+  msg ("adaptive lock: %llu acquires spun, %llu yielded, %llu blocked",
+       test.adaptive_lock.spin_cnt, test.adaptive_lock.yield_cnt,
+       test.adaptive_lock.block_cnt);
+
+  handoff ();
+  if (test.adaptive_lock.yield_cnt == 0)
+    fail ("waiters always blocked on a lock whose holder was ready");
+  msg ("adaptive lock: waiter yielded to the holder instead of blocking");
+}
+
+/* Runs THREAD_CNT contenders with the kind of lock selected by
+   ADAPTIVE, and returns the number of context switches done
+   until the last one finished. */
+static unsigned long long
+run (bool adaptive) 
+{
+  unsigned long long start;
+  int i;
+
+  test.adaptive = adaptive;
+  lock_init (&test.lock);
+  adaptive_lock_init (&test.adaptive_lock);
+  test.counter = 0;
+  sema_init (&test.done, 0);
+
+  start = switch_cnt ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "contender %d", i);
+      if (thread_create (name, PRI_DEFAULT, contender, NULL) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&test.done);
+  return switch_cnt () - start;
+}
+
+/* Contender thread. */
+static void
+contender (void *aux UNUSED) 
+{
+  int i, j;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      if (test.adaptive)
+        adaptive_lock_acquire (&test.adaptive_lock);
+      else
+        lock_acquire (&test.lock);
+
+      /* Read, dawdle, then write back, so that an unprotected
+         update would very likely be lost. */
+      int counter = test.counter;
+      for (j = 0; j < CS_LENGTH; j++)
+        barrier ();
+      test.counter = counter + 1;
+
+      if (test.adaptive)
+        adaptive_lock_release (&test.adaptive_lock);
+      else
+        lock_release (&test.lock);
+    }
+  sema_up (&test.done);
+}
+
+/* Acquires the adaptive lock, starts a waiter for it, and yields
+   while holding it, HANDOFF_CNT times.  When we run again, the
+   waiter should be waiting for us in thread_yield(), not in
+   lock_acquire(), and take the lock once we release it and
+   block. */
+static void
+handoff (void) 
+{
+  int i;
+
+  adaptive_lock_init (&test.adaptive_lock);
+  sema_init (&test.done, 0);
+  for (i = 0; i < HANDOFF_CNT; i++)
+    {
+      adaptive_lock_acquire (&test.adaptive_lock);
+      if (thread_create ("waiter", PRI_DEFAULT, waiter, NULL) == TID_ERROR)
+        fail ("couldn't create waiter %d", i);
+      thread_yield ();
+      adaptive_lock_release (&test.adaptive_lock);
+      sema_down (&test.done);
+    }
+}
+
+/* Waiter thread. */
+static void
+waiter (void *aux UNUSED) 
+{
+  adaptive_lock_acquire (&test.adaptive_lock);
+  adaptive_lock_release (&test.adaptive_lock);
+  sema_up (&test.done);
+}
+
+/* Returns the number of context switches done by all CPUs. */
+static unsigned long long
+switch_cnt (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  unsigned long long cnt = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    cnt += cpus[i].switch_cnt;
+  intr_set_level (old_level);
+  return cnt;
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(lock-adaptive\) (context switches|adaptive lock: \d+ acquires)/, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(lock-adaptive) begin
+(lock-adaptive) lock: counter is 8000.
+(lock-adaptive) adaptive lock: counter is 8000.
+(lock-adaptive) adaptive lock: waiter yielded to the holder instead of blocking
+(lock-adaptive) end
+EOF
+pass;
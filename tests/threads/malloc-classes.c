@@ -0,0 +1,112 @@
+/* Allocates blocks of many sizes, including ones in multi-page
+   arenas that cross page boundaries, and checks that their
+   contents survive and that they can be freed in any order.
+   Then checks that realloc() keeps a block in place when its
+   size class has room, copies the contents when it must move,
+   and shrinks and grows a big block in place. */
+
+#include <stdio.h>
+#include <string.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+
+#define BLOCK_CNT 200
+
+static uint8_t *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Fills the SIZE bytes at P with a pattern derived from TAG. */
+static void
+fill (uint8_t *p, size_t size, int tag)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    p[i] = (uint8_t) (tag + i);
+}
+
+/* Checks the pattern written by fill(). */
+static bool
+check (const uint8_t *p, size_t size, int tag)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != (uint8_t) (tag + i))
+      return false;
+  return true;
+}
+
+void
+test_malloc_classes (void)
+{
+  size_t free_before;
+  uint8_t *p, *q;
+  int i;
+
+  palloc_drain_caches ();
+  free_before = palloc_free_cnt (0);
+
+  random_init (0);
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      sizes[i] = random_ulong () % 7000 + 1;
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc(%zu) failed", sizes[i]);
+      fill (blocks[i], sizes[i], i);
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (!check (blocks[i], sizes[i], i))
+      fail ("block %d of %zu bytes was overwritten", i, sizes[i]);
+  msg ("%d blocks of up to 7000 bytes kept their contents", BLOCK_CNT);
+
+  /* Free every other block, then the rest. */
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    free (blocks[i]);
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      if (!check (blocks[i], sizes[i], i))
+        fail ("block %d of %zu bytes was overwritten", i, sizes[i]);
+      free (blocks[i]);
+    }
+
+  palloc_drain_caches ();
+  if (palloc_free_cnt (0) != free_before)
+    fail ("%zu free pages before, %zu after",
+          free_before, palloc_free_cnt (0));
+  msg ("all arenas were freed");
+
+  /* 2100 bytes come from a class with room for 2500. */
+  p = malloc (2100);
+  fill (p, 2100, 7);
+  q = realloc (p, 2500);
+  if (q != p)
+    fail ("realloc within size class moved the block");
+  if (!check (q, 2100, 7))
+    fail ("realloc in place lost contents");
+
+  /* 4000 bytes do not fit. */
+  p = realloc (q, 4000);
+  if (p == NULL || !check (p, 2100, 7))
+    fail ("realloc to a bigger class lost contents");
+
+  /* A big block shrinks in place. */
+  q = realloc (p, 20000);
+  if (q == NULL || !check (q, 2100, 7))
+    fail ("realloc to a big block lost contents");
+  p = realloc (q, 9000);
+  if (p != q)
+    fail ("shrinking a big block moved it");
+
+  /* ...and grows back into the pages it just gave up. */
+  q = realloc (p, 20000);
+  if (q != p)
+    fail ("growing a big block into free pages moved it");
+  if (!check (q, 2100, 7))
+    fail ("growing a big block lost contents");
+  free (q);
+  msg ("realloc kept blocks in place when there was room");
+}
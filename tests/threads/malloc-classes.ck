@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-classes) begin
+(malloc-classes) 200 blocks of up to 7000 bytes kept their contents
+(malloc-classes) all arenas were freed
+(malloc-classes) realloc kept blocks in place when there was room
+(malloc-classes) end
+EOF
+pass;
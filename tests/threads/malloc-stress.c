@@ -0,0 +1,134 @@
+/* Has several threads allocate, fill, check and free blocks of
+   random sizes as fast as they can, each keeping a small working
+   set, and checks that no block is ever handed to two threads or
+   corrupted.
+
+   Also reports the average cost of a malloc()/free() pair, in
+   TSC cycles. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define THREAD_CNT 8            /* Number of threads. */
+#define ITER_CNT 4000           /* Allocations per thread. */
+#define SLOT_CNT 16             /* Blocks each thread holds. */
+#define MAX_SIZE 600            /* Largest block allocated. */
+
+/* One thread's state. */
+struct stress
+  {
+    int id;
+    unsigned seed;              /* For the thread's own PRNG. */
+    uint64_t cycles;            /* Time spent in malloc() and free(). */
+    bool ok;                    /* No corruption seen? */
+    uint8_t *blocks[SLOT_CNT];
+    size_t sizes[SLOT_CNT];
+  };
+
+static struct stress threads[THREAD_CNT];
+static struct semaphore done;
+
+/* Returns a pseudo-random number from S's generator.  A shared
+   generator would serialize the threads. */
+static unsigned
+next_random (struct stress *s)
+{
+  s->seed = s->seed * 1103515245 + 12345;
+  return s->seed >> 8;
+}
+
+/* Returns true if the SIZE bytes at P all equal TAG. */
+static bool
+check (const uint8_t *p, size_t size, uint8_t tag)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != tag)
+      return false;
+  return true;
+}
+
+static void
+stresser (void *s_)
+{
+  struct stress *s = s_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      int slot = next_random (s) % SLOT_CNT;
+      uint8_t tag = s->id * SLOT_CNT + slot;
+      uint64_t start;
+
+      if (s->blocks[slot] != NULL)
+        {
+          if (!check (s->blocks[slot], s->sizes[slot], tag))
+            s->ok = false;
+          start = rdtsc ();
+          free (s->blocks[slot]);
+          s->cycles += rdtsc () - start;
+        }
+
+      s->sizes[slot] = next_random (s) % MAX_SIZE + 1;
+      start = rdtsc ();
+      s->blocks[slot] = malloc (s->sizes[slot]);
+      s->cycles += rdtsc () - start;
+      if (s->blocks[slot] == NULL)
+        {
+          s->ok = false;
+          break;
+        }
+      memset (s->blocks[slot], tag, s->sizes[slot]);
+    }
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (s->blocks[i] != NULL)
+      {
+        uint8_t tag = s->id * SLOT_CNT + i;
+
+        if (!check (s->blocks[i], s->sizes[i], tag))
+          s->ok = false;
+        free (s->blocks[i]);
+      }
+  sema_up (&done);
+}
+
+void
+test_malloc_stress (void)
+{
+  uint64_t cycles = 0;
+  int i;
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      struct stress *s = &threads[i];
+      char name[16];
+
+      s->id = i;
+      s->seed = i + 1;
+      s->ok = true;
+      snprintf (name, sizeof name, "stress %d", i);
+      if (thread_create (name, PRI_DEFAULT, stresser, s) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      if (!threads[i].ok)
+        fail ("thread %d saw a corrupted or missing block", i);
+      cycles += threads[i].cycles;
+    }
+  msg ("%d threads did %d allocations each without corruption",
+       THREAD_CNT, ITER_CNT);
+  msg ("latency: %llu cycles per malloc/free pair",
+       (unsigned long long) (cycles / (THREAD_CNT * ITER_CNT)));
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(malloc-stress\) latency: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(malloc-stress) begin
+(malloc-stress) 8 threads did 4000 allocations each without corruption
+(malloc-stress) end
+EOF
+pass;
@@ -0,0 +1,120 @@
+/* Exercises the page allocator with a random mix of multi-page
+   allocations and frees, and checks that no two allocations
+   overlap and that freeing everything merges the pool back to
+   the state it started in.
+
+   Also reports the average cost of an allocation and a free, in
+   TSC cycles, and how fragmented the pool was with half of the
+   blocks freed: the largest block it could still hand out,
+   against the number of free pages.
+
+   Single pages freed into the per-CPU page caches, like those on
+   the zeroed lists, do not reach the buddy allocator, so these
+   are drained before each look at the pool. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define BLOCK_CNT 256           /* Number of allocations. */
+#define MAX_PAGES 8             /* Largest allocation, in pages. */
+
+/* One allocation. */
+struct block
+  {
+    uint8_t *pages;             /* First page, or NULL if free. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+static struct block blocks[BLOCK_CNT];
+
+/* Returns true if every page of B still starts with B's tag. */
+static bool
+block_intact (const struct block *b)
+{
+  size_t i;
+
+  for (i = 0; i < b->page_cnt; i++)
+    if (*(const struct block **) (b->pages + i * PGSIZE) != b)
+      return false;
+  return true;
+}
+
+void
+test_palloc_buddy (void)
+{
+  size_t free_before, largest_before;
+  uint64_t alloc_cycles = 0, free_cycles = 0;
+  size_t free_cnt = 0;
+  int i;
+
+  random_init (0);
+  palloc_drain_caches ();
+  free_before = palloc_free_cnt (0);
+  largest_before = palloc_largest_free (0);
+
+  /* Allocate, tagging every page with its block. */
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      struct block *b = &blocks[i];
+      uint64_t start;
+      size_t j;
+
+      b->page_cnt = random_ulong () % MAX_PAGES + 1;
+      start = rdtsc ();
+      b->pages = palloc_get_multiple (0, b->page_cnt);
+      alloc_cycles += rdtsc () - start;
+      if (b->pages == NULL)
+        fail ("allocation %d of %zu pages failed", i, b->page_cnt);
+      for (j = 0; j < b->page_cnt; j++)
+        *(struct block **) (b->pages + j * PGSIZE) = b;
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (!block_intact (&blocks[i]))
+      fail ("block %d overlaps another", i);
+  msg ("allocated %d blocks without overlap", BLOCK_CNT);
+
+  /* Free a random half. */
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (random_ulong () % 2)
+      {
+        uint64_t start = rdtsc ();
+        palloc_free_multiple (blocks[i].pages, blocks[i].page_cnt);
+        free_cycles += rdtsc () - start;
+        blocks[i].pages = NULL;
+        free_cnt++;
+      }
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i].pages != NULL && !block_intact (&blocks[i]))
+      fail ("block %d was damaged by freeing others", i);
+  palloc_drain_caches ();
+  msg ("fragmentation: largest free block %zu of %zu free pages",
+       palloc_largest_free (0), palloc_free_cnt (0));
+
+  /* Free the rest. */
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i].pages != NULL)
+      {
+        uint64_t start = rdtsc ();
+        palloc_free_multiple (blocks[i].pages, blocks[i].page_cnt);
+        free_cycles += rdtsc () - start;
+        blocks[i].pages = NULL;
+        free_cnt++;
+      }
+  msg ("latency: %llu cycles per allocation, %llu per free",
+       (unsigned long long) (alloc_cycles / BLOCK_CNT),
+       (unsigned long long) (free_cycles / free_cnt));
+
+  palloc_drain_caches ();
+  if (palloc_free_cnt (0) != free_before)
+    fail ("%zu pages free after freeing everything, %zu before",
+          palloc_free_cnt (0), free_before);
+  if (palloc_largest_free (0) != largest_before)
+    fail ("largest free block is %zu pages after freeing everything, "
+          "%zu before", palloc_largest_free (0), largest_before);
+  msg ("freed blocks merged back together");
+}
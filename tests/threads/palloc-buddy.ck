@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(palloc-buddy\) (fragmentation|latency): /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) allocated 256 blocks without overlap
+(palloc-buddy) freed blocks merged back together
+(palloc-buddy) end
+EOF
+pass;
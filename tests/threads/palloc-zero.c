@@ -0,0 +1,65 @@
+/* Dirties and frees a batch of pages, sleeps so that the
+   background zeroing thread can run, and then checks that pages
+   allocated with PAL_ZERO are all zeros.
+
+   Also reports the average cost of those allocations, in TSC
+   cycles, which should not include zeroing a page. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define PAGE_CNT 32             /* Fewer than the zeroed list holds. */
+
+static void *pages[PAGE_CNT];
+
+/* Returns true if the page at PAGE is all zeros. */
+static bool
+page_is_zero (const void *page)
+{
+  const uint64_t *p = page;
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *p; i++)
+    if (p[i] != 0)
+      return false;
+  return true;
+}
+
+void
+test_palloc_zero (void)
+{
+  uint64_t cycles = 0;
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ASSERT);
+      memset (pages[i], 0x5a, PGSIZE);
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+
+  /* Let the zeroing thread catch up. */
+  timer_sleep (10);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      uint64_t start = rdtsc ();
+      pages[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      cycles += rdtsc () - start;
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    if (!page_is_zero (pages[i]))
+      fail ("PAL_ZERO page %d is not zero", i);
+  msg ("all %d PAL_ZERO pages were zero", PAGE_CNT);
+  msg ("latency: %llu cycles per PAL_ZERO allocation",
+       (unsigned long long) (cycles / PAGE_CNT));
+
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(palloc-zero\) latency: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) all 32 PAL_ZERO pages were zero
+(palloc-zero) end
+EOF
+pass;
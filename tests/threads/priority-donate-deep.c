@@ -0,0 +1,96 @@
+/* Stress test for nested priority donation.
+
+   The main thread sets its priority to PRI_MIN, acquires lock 0
+   and creates threads 1 through 63, thread I with priority
+   PRI_MIN + I.  Thread I acquires lock I, then blocks acquiring
+   lock I - 1, so every new thread extends a single chain of
+   donations that ends in the main thread, 64 threads deep.
+   After each thread blocks, the main thread must have received
+   its priority through the whole chain.
+
+   When the main thread releases lock 0, the chain unwinds: each
+   thread runs with the donated priority of the thread above it
+   until it releases its own lock, so the threads must finish in
+   reverse order of creation. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define CHAIN_DEPTH 64
+
+struct donor
+  {
+    struct lock *mine;          /* Lock this thread holds. */
+    struct lock *next;          /* Lock held by the previous thread. */
+  };
+
+static struct lock locks[CHAIN_DEPTH - 1];
+static struct donor donors[CHAIN_DEPTH];
+static int finish_order[CHAIN_DEPTH];
+static int finish_cnt;
+
+static thread_func donor_thread_func;
+
+void
+test_priority_donate_deep (void) 
+{
+  int i, wrong;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+  ASSERT (PRI_MIN + CHAIN_DEPTH - 1 <= PRI_MAX);
+
+  thread_set_priority (PRI_MIN);
+  for (i = 0; i < CHAIN_DEPTH - 1; i++)
+    lock_init (&locks[i]);
+  finish_cnt = 0;
+
+  lock_acquire (&locks[0]);
+  wrong = 0;
+  for (i = 1; i < CHAIN_DEPTH; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "donor %d", i);
+      donors[i].mine = i < CHAIN_DEPTH - 1 ? &locks[i] : NULL;
+      donors[i].next = &locks[i - 1];
+      thread_create (name, PRI_MIN + i, donor_thread_func, &donors[i]);
+      if (thread_get_priority () != PRI_MIN + i)
+        {
+          msg ("After donor %d blocked, main has priority %d, not %d.",
+               i, thread_get_priority (), PRI_MIN + i);
+          wrong++;
+        }
+    }
+  if (wrong == 0)
+    msg ("Main thread received every donation along the chain.");
+
+  lock_release (&locks[0]);
+
+  for (i = 0; i < finish_cnt; i++)
+    if (finish_order[i] != CHAIN_DEPTH - 1 - i)
+      fail ("Donor %d finished in position %d.", finish_order[i], i);
+  if (finish_cnt != CHAIN_DEPTH - 1)
+    fail ("Only %d donors finished.", finish_cnt);
+  msg ("Donors finished in reverse order of creation.");
+  msg ("Main thread finishing with priority %d.", thread_get_priority ());
+}
+
+static void
+donor_thread_func (void *donor_) 
+{
+  struct donor *donor = donor_;
+  int id = donor - donors;
+
+  if (donor->mine != NULL)
+    lock_acquire (donor->mine);
+  lock_acquire (donor->next);
+  lock_release (donor->next);
+  if (donor->mine != NULL)
+    lock_release (donor->mine);
+
+  finish_order[finish_cnt++] = id;
+}
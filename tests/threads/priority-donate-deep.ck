@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-deep) begin
+(priority-donate-deep) Main thread received every donation along the chain.
+(priority-donate-deep) Donors finished in reverse order of creation.
+(priority-donate-deep) Main thread finishing with priority 0.
+(priority-donate-deep) end
+EOF
+pass;
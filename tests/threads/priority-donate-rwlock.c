@@ -0,0 +1,75 @@
+/* The main thread acquires a reader-writer lock shared.  A
+   higher-priority reader can still share it, but a writer must
+   wait and donates its priority to the main thread.  A reader of
+   even higher priority that arrives after the writer must queue
+   behind it, and its donation passes to the writer once the main
+   thread releases the lock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader1_thread_func;
+static thread_func writer_thread_func;
+static thread_func reader2_thread_func;
+
+void
+test_priority_donate_rwlock (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_acquire_shared (&rwlock);
+  thread_create ("reader1", PRI_DEFAULT + 1, reader1_thread_func, &rwlock);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  thread_create ("reader2", PRI_DEFAULT + 3, reader2_thread_func, &rwlock);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_shared (&rwlock);
+  msg ("writer, reader2 must already have finished, in that order.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+reader1_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_shared (rwlock);
+  msg ("reader1: got the lock shared");
+  rwlock_release_shared (rwlock);
+  msg ("reader1: done");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_exclusive (rwlock);
+  msg ("writer: got the lock exclusive, priority %d",
+       thread_get_priority ());
+  rwlock_release_exclusive (rwlock);
+  msg ("writer: done");
+}
+
+static void
+reader2_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_acquire_shared (rwlock);
+  msg ("reader2: got the lock shared");
+  rwlock_release_shared (rwlock);
+  msg ("reader2: done");
+}
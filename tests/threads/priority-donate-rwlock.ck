@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) reader1: got the lock shared
+(priority-donate-rwlock) reader1: done
+(priority-donate-rwlock) This thread should have priority 33.  Actual priority: 33.
+(priority-donate-rwlock) This thread should have priority 34.  Actual priority: 34.
+(priority-donate-rwlock) writer: got the lock exclusive, priority 34
+(priority-donate-rwlock) reader2: got the lock shared
+(priority-donate-rwlock) reader2: done
+(priority-donate-rwlock) writer: done
+(priority-donate-rwlock) writer, reader2 must already have finished, in that order.
+(priority-donate-rwlock) This should be the last line before finishing this test.
+(priority-donate-rwlock) end
+EOF
+pass;
@@ -0,0 +1,93 @@
+/* Creates an object cache with a constructor, allocates enough
+   objects to fill many slabs, and checks that every object is
+   aligned, distinct and in its constructed state.  Then frees
+   them all and checks that kmem_reclaim() gives every slab page
+   back to the page allocator. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_CNT 512
+#define OBJ_MAGIC 0x0b1ec7ed
+
+struct obj
+  {
+    unsigned magic;             /* Set by the constructor. */
+    int owner;                  /* Set by the user. */
+    char payload[64];
+  };
+
+static struct obj *objs[OBJ_CNT];
+static int ctor_cnt;
+
+static void
+obj_ctor (void *obj_)
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+  obj->owner = -1;
+  ctor_cnt++;
+}
+
+void
+test_slab_cache (void)
+{
+  struct kmem_cache *cache;
+  size_t free_before, free_after, reclaimed;
+  int i, j;
+
+  cache = kmem_cache_create ("test", sizeof (struct obj), 16, obj_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create failed");
+
+  palloc_drain_caches ();
+  free_before = palloc_free_cnt (0);
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if ((uintptr_t) objs[i] % 16 != 0)
+        fail ("object %d is misaligned", i);
+      if (objs[i]->magic != OBJ_MAGIC || objs[i]->owner != -1)
+        fail ("object %d is not constructed", i);
+      objs[i]->owner = i;
+    }
+  for (i = 0; i < OBJ_CNT; i++)
+    for (j = i + 1; j < OBJ_CNT; j++)
+      if (objs[i] == objs[j])
+        fail ("objects %d and %d are the same", i, j);
+  for (i = 0; i < OBJ_CNT; i++)
+    if (objs[i]->owner != i)
+      fail ("object %d was overwritten", i);
+  msg ("allocated %d constructed objects", OBJ_CNT);
+
+  /* Return objects in their constructed state. */
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i]->owner = -1;
+      kmem_cache_free (cache, objs[i]);
+    }
+
+  /* Reused objects must not be constructed again. */
+  j = ctor_cnt;
+  objs[0] = kmem_cache_alloc (cache);
+  if (objs[0]->magic != OBJ_MAGIC || ctor_cnt != j)
+    fail ("reused object was reconstructed");
+  kmem_cache_free (cache, objs[0]);
+  msg ("reused objects kept their constructed state");
+
+  reclaimed = kmem_reclaim ();
+  palloc_drain_caches ();
+  free_after = palloc_free_cnt (0);
+  if (reclaimed == 0 || free_after < free_before)
+    fail ("reclaimed %zu pages, %zu free pages before, %zu after",
+          reclaimed, free_before, free_after);
+  msg ("empty slabs were reclaimed");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) allocated 512 constructed objects
+(slab-cache) reused objects kept their constructed state
+(slab-cache) empty slabs were reclaimed
+(slab-cache) end
+EOF
+pass;
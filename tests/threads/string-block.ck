@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(string-block\) throughput: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(string-block) begin
+(string-block) checked sizes 0 through 99 at every alignment
+(string-block) end
+EOF
+pass;
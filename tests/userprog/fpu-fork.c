@@ -0,0 +1,82 @@
+/* Checks that SSE register state is private to each process:
+   the child of fork() starts with a copy of its parent's %xmm0,
+   and parent and child each keep their own value in %xmm0 while
+   the timer switches between them. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of times to check %xmm0 while the other process runs. */
+#define CHECK_CNT 2000000
+
+static void
+load_xmm0 (const uint64_t v[2])
+{
+  asm volatile ("movdqu (%0), %%xmm0" : : "r" (v) : "memory");
+}
+
+static void
+store_xmm0 (uint64_t v[2])
+{
+  asm volatile ("movdqu %%xmm0, (%0)" : : "r" (v) : "memory");
+}
+
+/* Returns true if %xmm0 holds V. */
+static bool
+xmm0_is (const uint64_t v[2])
+{
+  uint64_t cur[2];
+
+  store_xmm0 (cur);
+  return cur[0] == v[0] && cur[1] == v[1];
+}
+
+/* Returns true if %xmm0 keeps holding V for CHECK_CNT checks. */
+static bool
+xmm0_holds (const uint64_t v[2])
+{
+  int i;
+
+  for (i = 0; i < CHECK_CNT; i++)
+    if (!xmm0_is (v))
+      return false;
+  return true;
+}
+
+void
+test_main (void) 
+{
+  static const uint64_t parent_val[2] = {0x0123456789abcdefULL,
+                                         0xfedcba9876543210ULL};
+  static const uint64_t child_val[2] = {0x5555aaaa5555aaaaULL,
+                                        0xaaaa5555aaaa5555ULL};
+  static const uint64_t after_val[2] = {0x0f0f0f0f0f0f0f0fULL,
+                                        0xf0f0f0f0f0f0f0f0ULL};
+  bool parent_ok;
+  int pid;
+
+  load_xmm0 (parent_val);
+  if ((pid = fork ("child")))
+    {
+      load_xmm0 (after_val);
+      parent_ok = xmm0_holds (after_val);
+      wait (pid);
+      if (parent_ok)
+        msg ("parent: xmm0 kept its value");
+      else
+        fail ("parent: xmm0 changed");
+    }
+  else
+    {
+      if (!xmm0_is (parent_val))
+        fail ("child: xmm0 not inherited from parent");
+      msg ("child: xmm0 inherited from parent");
+      load_xmm0 (child_val);
+      if (!xmm0_holds (child_val))
+        fail ("child: xmm0 changed");
+      msg ("child: xmm0 kept its value");
+      exit (0);
+    }
+}
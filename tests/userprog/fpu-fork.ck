@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fpu-fork) begin
+(fpu-fork) child: xmm0 inherited from parent
+(fpu-fork) child: xmm0 kept its value
+child: exit(0)
+(fpu-fork) parent: xmm0 kept its value
+(fpu-fork) end
+fpu-fork: exit(0)
+EOF
+pass;
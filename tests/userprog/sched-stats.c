@@ -0,0 +1,69 @@
+/* Waits for a child process, then reads the scheduling
+   statistics with sched_stats() and prints them the way ps
+   would.  Waiting for the child blocks us, so our own record
+   must show at least one voluntary switch and one wakeup. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of records to ask for. */
+#define RECORD_CNT 64
+
+static struct sched_stats stats[RECORD_CNT];
+
+/* Returns the number of wakeups in C's latency histogram. */
+static uint64_t
+latency_sum (const struct sched_counts *c)
+{
+  uint64_t sum = 0;
+  int i;
+
+  for (i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+    sum += c->latency[i];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  const struct sched_stats *self = NULL;
+  int pid, cnt, i;
+
+  if ((pid = fork ("child")) == 0)
+    exit (81);
+  if (wait (pid) != 81)
+    fail ("wait for child failed");
+
+  cnt = sched_stats (stats, RECORD_CNT);
+  if (cnt < 2)
+    fail ("sched_stats returned %d records", cnt);
+  if (stats[0].tid != 0)
+    fail ("first record is tid %d, not the total", stats[0].tid);
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct sched_stats *s = &stats[i];
+
+      msg ("ps: %5d %-16s %3d %14llu %5llu %5llu %5llu", s->tid, s->name,
+           s->priority, (unsigned long long) s->counts.wait,
+           (unsigned long long) s->counts.voluntary,
+           (unsigned long long) s->counts.involuntary,
+           (unsigned long long) s->counts.wakeups);
+      if (latency_sum (&s->counts) != s->counts.wakeups)
+        fail ("%s: latency histogram does not add up to wakeups", s->name);
+      if (s->tid != 0 && !strcmp (s->name, "sched-stats"))
+        self = s;
+    }
+
+  if (self == NULL)
+    fail ("no record for this process");
+  if (self->counts.voluntary < 1 || self->counts.wakeups < 1)
+    fail ("no voluntary switch or wakeup recorded for this process");
+  if (stats[0].counts.voluntary < self->counts.voluntary
+      || stats[0].counts.wakeups < self->counts.wakeups)
+    fail ("total is less than this process's share");
+  msg ("own record shows a voluntary switch and a wakeup");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(sched-stats\) ps: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(sched-stats) begin
+child: exit(81)
+(sched-stats) own record shows a voluntary switch and a wakeup
+(sched-stats) end
+sched-stats: exit(0)
+EOF
+pass;
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(fork-cow\) cycles: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(fork-cow) begin
+(fork-cow) forked 16 pages
+(fork-cow) forked 256 pages
+(fork-cow) forked 1024 pages
+(fork-cow) end
+EOF
+pass;
@@ -0,0 +1,86 @@
+/* Fills the running thread's supplemental page table with
+   uninitialized anonymous pages in a few layouts and checks that
+   spt_find_page() finds every mapped page and none of the
+   unmapped pages just past them.
+
+   Also reports the cycles that spt_find_page(), the lookup on
+   every page fault, takes per call: for sequential addresses,
+   which mostly hit the last leaf, for random addresses within
+   the mapping, and for the unmapped addresses.  And the memory
+   the table's nodes use per mapped page. */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#include "intrinsic.h"
+
+/* Lookups timed per measurement. */
+#define LOOKUPS 100000
+
+/* Returns the address of page number I of a mapping starting at
+   BASE, with a gap of STRIDE - 1 pages after each page. */
+static void *
+page_addr (uintptr_t base, size_t stride, size_t i)
+{
+  return (void *) (base + i * stride * PGSIZE);
+}
+
+/* Maps PAGE_CNT pages and times lookups in them. */
+static void
+lookup (const char *name, uintptr_t base, size_t page_cnt, size_t stride)
+{
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  uint64_t seq, rnd, miss, start;
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    if (!vm_alloc_page (VM_ANON, page_addr (base, stride, i), true))
+      fail ("%s: allocating page %zu failed", name, i);
+
+  start = rdtsc ();
+  for (i = 0; i < LOOKUPS; i++)
+    if (spt_find_page (spt, page_addr (base, stride, i % page_cnt)) == NULL)
+      fail ("%s: page %zu missing", name, i % page_cnt);
+  seq = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < LOOKUPS; i++)
+    {
+      size_t page = random_ulong () % page_cnt;
+      if (spt_find_page (spt, page_addr (base, stride, page)) == NULL)
+        fail ("%s: page %zu missing", name, page);
+    }
+  rnd = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < LOOKUPS; i++)
+    if (spt_find_page (spt, page_addr (base, stride,
+                                       page_cnt + i % page_cnt)) != NULL)
+      fail ("%s: unmapped page %zu found", name, page_cnt + i % page_cnt);
+  miss = rdtsc () - start;
+
+  msg ("%s: found %zu pages", name, page_cnt);
+  msg ("cycles: %s: seq %llu, random %llu, miss %llu, %zu bytes/page",
+       name, (unsigned long long) (seq / LOOKUPS),
+       (unsigned long long) (rnd / LOOKUPS),
+       (unsigned long long) (miss / LOOKUPS),
+       spt->node_cnt * PGSIZE / page_cnt);
+
+  supplemental_page_table_kill (spt);
+}
+
+void
+test_spt_lookup (void)
+{
+  random_init (0);
+  supplemental_page_table_init (&thread_current ()->spt);
+
+  lookup ("small", 0x400000, 16, 1);
+  lookup ("dense", 0x400000, 16384, 1);
+  lookup ("sparse", 0x400000, 4096, 512);
+  lookup ("stack", USER_STACK - 256 * PGSIZE, 256, 1);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = grep (!/^\(spt-lookup\) cycles: /, @output);
+compare_output ("run", \@output, [<<'EOF']);
+(spt-lookup) begin
+(spt-lookup) small: found 16 pages
+(spt-lookup) dense: found 16384 pages
+(spt-lookup) sparse: found 4096 pages
+(spt-lookup) stack: found 256 pages
+(spt-lookup) end
+EOF
+pass;
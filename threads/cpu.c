@@ -0,0 +1,18 @@
+#include "threads/cpu.h"
+
+/* Per-CPU state.  cpus[0] is the bootstrap processor, the one
+   running main().
+
+   Only the bootstrap processor is ever started, so cpu_cnt and
+   cpu_online_cnt are both 1.  The scheduler, the allocators, and
+   the statistics keep their state in cpus[] all the same, so that
+   they can run on more processors without being restructured.
+   Before that can happen, the code that still relies on
+   intr_disable() for mutual exclusion, such as semaphores, the
+   sleep wheel, and the allocators, must be made safe across
+   CPUs, and the kernel needs the local APIC to start the other
+   processors, send them interrupts, and shoot down their TLB
+   entries. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+int cpu_online_cnt = 1;
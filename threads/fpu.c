@@ -0,0 +1,162 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Lazy FPU switching.
+
+   The kernel is built without floating point or SSE, so only
+   user programs use the FPU registers, and most never do.  A
+   thread's FPU state is therefore saved and loaded only if it
+   uses the FPU:
+
+   - Each switch away from a thread sets CR0.TS, first saving
+     the FPU registers if the thread used them since it was
+     switched in.  Saving on every such switch keeps the saved
+     copy current, so the thread may resume on any CPU.
+
+   - The first FPU or SSE instruction a thread runs after being
+     switched in then raises #NM, device not available.
+     fpu_trap() clears CR0.TS and loads the thread's saved state,
+     unless this CPU's registers still hold it, then the
+     instruction is restarted.
+
+   A thread that never uses the FPU never takes the trap and
+   never has a save area allocated. */
+
+/* CR0 and CR4 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR0_MP (1 << 1)             /* Monitor coprocessor. */
+#define CR0_EM (1 << 2)             /* x87 emulation. */
+#define CR0_TS (1 << 3)             /* Task switched. */
+#define CR0_NE (1 << 5)             /* Native x87 error reporting. */
+#define CR4_OSFXSR (1 << 9)         /* FXSAVE and SSE enabled. */
+#define CR4_OSXMMEXCPT (1 << 10)    /* SSE exceptions raise #XF. */
+
+/* FXSAVE area.  FXSAVE requires 16-byte alignment, which malloc()
+   does not promise, so AREA is aligned by hand within RAW. */
+struct fpu_state {
+	uint8_t raw[FPU_STATE_SIZE + 15];
+};
+
+/* FPU state of a freshly initialized FPU, given to each thread
+   on its first use. */
+static uint8_t initial_state[FPU_STATE_SIZE] __attribute__ ((aligned (16)));
+
+/* Returns the aligned FXSAVE area of T, which must have one. */
+static void *
+fpu_area (struct thread *t) {
+	return (void *) ROUND_UP ((uintptr_t) t->fpu->raw, 16);
+}
+
+/* Enables the FPU and SSE, records the initial FPU state, and
+   sets CR0.TS so that the first use by any thread traps. */
+void
+fpu_init (void) {
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	lcr0 ((rcr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+	asm volatile ("fninit");
+	fxsave (initial_state);
+	lcr0 (rcr0 () | CR0_TS);
+}
+
+/* Handles a device-not-available exception in the running
+   thread: gives it the FPU, loading its saved state.  Returns
+   false if memory for the state cannot be allocated. */
+bool
+fpu_trap (void) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	struct cpu *cpu;
+
+	/* First use: start from a clean FPU.  malloc() may sleep, so
+	   do this before turning interrupts off. */
+	if (curr->fpu == NULL) {
+		curr->fpu = malloc (sizeof *curr->fpu);
+		if (curr->fpu == NULL)
+			return false;
+		memcpy (fpu_area (curr), initial_state, FPU_STATE_SIZE);
+	}
+
+	old_level = intr_disable ();
+	cpu = this_cpu ();
+	clts ();
+	if (cpu->fpu_owner != curr || curr->fpu_cpu != cpu) {
+		fxrstor (fpu_area (curr));
+		cpu->fpu_owner = curr;
+		curr->fpu_cpu = cpu;
+	}
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Called by the scheduler with interrupts off when switching
+   away from thread PREV.  Saves PREV's FPU state if it used the
+   FPU during this time slice, and arms the trap for the next
+   thread. */
+void
+fpu_switch_out (struct thread *prev) {
+	uint64_t cr0 = rcr0 ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (cr0 & CR0_TS)
+		return;
+	if (prev->fpu != NULL)
+		fxsave (fpu_area (prev));
+	lcr0 (cr0 | CR0_TS);
+}
+
+/* Writes the running thread's FPU registers, if it is using
+   them, to its save area, leaving the FPU in use. */
+void
+fpu_save (void) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level = intr_disable ();
+
+	if (!(rcr0 () & CR0_TS) && curr->fpu != NULL)
+		fxsave (fpu_area (curr));
+	intr_set_level (old_level);
+}
+
+/* Gives DST a copy of SRC's FPU state, for fork().  SRC's saved
+   state must be current: SRC must be switched out or have called
+   fpu_save() since it last used the FPU.  Returns false if memory
+   cannot be allocated. */
+bool
+fpu_copy (struct thread *dst, struct thread *src) {
+	ASSERT (dst->fpu == NULL);
+
+	if (src->fpu == NULL)
+		return true;
+	dst->fpu = malloc (sizeof *dst->fpu);
+	if (dst->fpu == NULL)
+		return false;
+	memcpy (fpu_area (dst), fpu_area (src), FPU_STATE_SIZE);
+	return true;
+}
+
+/* Discards the FPU state of T, the running thread, e.g. when it
+   exits or executes a new program. */
+void
+fpu_release (struct thread *t) {
+	enum intr_level old_level;
+	struct fpu_state *fpu = t->fpu;
+
+	ASSERT (t == thread_current ());
+
+	if (fpu == NULL)
+		return;
+
+	old_level = intr_disable ();
+	t->fpu = NULL;
+	t->fpu_cpu = NULL;
+	lcr0 (rcr0 () | CR0_TS);
+	intr_set_level (old_level);
+	free (fpu);
+}
@@ -13,13 +13,16 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memprof.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -49,6 +52,9 @@ static bool format_filesys;
 /* -q: Power off after kernel tasks complete? */
 bool power_off_when_done;
 
+/* -sched-stats: Print scheduling statistics at power off? */
+static bool print_sched_stats;
+
 bool thread_tests;
 
 static void bss_init (void);
@@ -85,6 +91,8 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	kmem_init ();
+	memprof_init ();
 	paging_init (mem_end);
 
 #ifdef USERPROG
@@ -94,6 +102,7 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	fpu_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
@@ -103,6 +112,7 @@ main (void) {
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
+	palloc_zero_start ();
 	serial_init_queue ();
 	timer_calibrate ();
 
@@ -142,7 +152,12 @@ bss_init (void) {
 
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * Memory is mapped with 2 MB pages, which need no page tables
+ * and far fewer TLB entries, except for the 2 MB regions that
+ * hold kernel text, which must be read-only, or that extend past
+ * MEM_END. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
@@ -150,17 +165,32 @@ paging_init (uint64_t mem_end) {
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
+	uint64_t text_start = vtop (&start);
+	uint64_t text_end = vtop (&_end_kernel_text);
+
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
-		uint64_t va = (uint64_t) ptov(pa);
-
-		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
-			perm &= ~PTE_W;
-
-		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
-			*pte = pa | perm;
+	for (uint64_t huge = 0; huge < mem_end; huge += HUGE_PGSIZE) {
+		uint64_t huge_end = huge + HUGE_PGSIZE;
+
+		if (huge_end <= mem_end
+				&& (huge_end <= text_start || text_end <= huge)) {
+			pte = pml4e_walk_pde (pml4, (uint64_t) ptov (huge), 1);
+			if (pte != NULL)
+				*pte = huge | PTE_P | PTE_W | PTE_PS;
+			continue;
+		}
+
+		for (uint64_t pa = huge; pa < huge_end && pa < mem_end; pa += PGSIZE) {
+			uint64_t va = (uint64_t) ptov(pa);
+
+			perm = PTE_P | PTE_W;
+			if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+				perm &= ~PTE_W;
+
+			if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
+				*pte = pa | perm;
+		}
 	}
 
 	// reload cr3
@@ -221,6 +251,8 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-sched-stats"))
+			print_sched_stats = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -252,6 +284,14 @@ run_task (char **argv) {
 	printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef KMEM_PROFILE
+/* Prints the call sites holding the most kernel memory. */
+static void
+run_memprof (char **argv UNUSED) {
+	memprof_print (MEMPROF_TOP);
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -266,6 +306,9 @@ run_actions (char **argv) {
 	/* Table of supported actions. */
 	static const struct action actions[] = {
 		{"run", 2, run_task},
+#ifdef KMEM_PROFILE
+		{"memprof", 1, run_memprof},
+#endif
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},
 		{"cat", 2, fsutil_cat},
@@ -319,6 +362,9 @@ usage (void) {
 			"Use these actions indirectly via `pintos' -g and -p options:\n"
 			"  put FILE           Put FILE into file system from scratch disk.\n"
 			"  get FILE           Get FILE from file system into scratch disk.\n"
+#endif
+#ifdef KMEM_PROFILE
+			"  memprof            Print the top kernel memory users.\n"
 #endif
 			"\nOptions:\n"
 			"  -h                 Print this help message and power off.\n"
@@ -326,6 +372,7 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -sched-stats       Print scheduling statistics at power off.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -354,6 +401,15 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	kmem_print_stats ();
+	memprof_print (MEMPROF_TOP);
+#ifdef VM
+	vm_print_stats ();
+#endif
+	if (print_sched_stats)
+		thread_print_sched_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -5,41 +5,93 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/memprof.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
+   The size of each request, in bytes, is rounded up to the next
+   size class and assigned to the "descriptor" that manages blocks
+   of that size.  The descriptor keeps a list of free blocks.  If
    the free list is nonempty, one of its blocks is used to
    satisfy the request.
 
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   Otherwise, a new "arena" of one or more pages is obtained from
+   the page allocator (if none is available, malloc() returns a
+   null pointer).  The new arena is divided into blocks, all of
+   which are added to the descriptor's free list.  Then we return
+   one of the new blocks.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Size classes step by about a half power of 2, and the larger
+   ones are sized to divide their arena evenly, so no request
+   wastes more than about a third of its block.  Classes above
+   half a page use multi-page arenas, in which a block may cross
+   a page boundary; the page allocator records the arena as the
+   owner of each of its pages so that free() can still find it.
+
+   In front of each descriptor's free list, every CPU keeps a
+   small stack of free blocks of that size, protected by a
+   spinlock, so that most calls take no lock that another CPU
+   contends for.  Blocks move between a stack and the free list
+   in batches.  The descriptor's lock is a spinlock too, held
+   only to move blocks on and off the free list: arenas are
+   obtained from and returned to the page allocator, which may
+   sleep, without it.  So malloc() and free() only sleep when
+   they need the page allocator's pool lock.
+
+   Blocks bigger than the largest class are handled by allocating
+   contiguous pages with the page allocator and sticking the
+   allocation size at the beginning of the allocated block's
+   arena header. */
+
+/* Size classes: block size and pages per arena.  Block sizes are
+   multiples of 8 and chosen to fill the arena, after its header,
+   with little left over. */
+static const struct {
+	size_t block_size;
+	size_t arena_pages;
+} classes[] = {
+	{16, 1}, {32, 1}, {48, 1}, {64, 1}, {96, 1}, {128, 1},
+	{192, 1}, {256, 1}, {400, 1}, {576, 1}, {672, 1}, {1016, 1},
+	{1352, 1}, {2032, 1}, {2720, 2}, {3272, 4}, {5448, 4}, {6128, 3},
+};
+#define CLASS_CNT (sizeof classes / sizeof *classes)
+
+/* Maximum number of blocks in a per-CPU stack. */
+#define CPU_BLOCKS 16
+
+/* Per-CPU stack of free blocks of one size class. */
+struct desc_cpu {
+	struct spinlock lock;       /* Taken by other CPUs only to drain. */
+	size_t cnt;                 /* Number of blocks in BLOCKS. */
+	struct block *blocks[CPU_BLOCKS]; /* Most recently freed last. */
+
+	/* Statistics. */
+	uint64_t alloc_cnt;         /* Blocks handed out. */
+	uint64_t free_cnt;          /* Blocks freed. */
+	uint64_t hit_cnt;           /* Allocations served from BLOCKS. */
+	uint64_t req_bytes;         /* Bytes requested. */
+};
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
+	size_t arena_pages;         /* Number of pages in an arena. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t cpu_max;             /* Blocks each CPU may keep. */
 	struct list free_list;      /* List of free blocks. */
-	struct lock lock;           /* Lock. */
+	struct spinlock lock;       /* Protects FREE_LIST, ARENA_CNT, and
+	                               its arenas' FREE_CNTs. */
+	size_t arena_cnt;           /* Arenas now allocated. */
+	struct desc_cpu cpus[CPU_MAX]; /* Indexed by CPU id. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -58,34 +110,100 @@ struct block {
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[CLASS_CNT]; /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Per-CPU statistics for big blocks and realloc(). */
+struct stats_cpu {
+	struct spinlock lock;       /* Taken by other CPUs only to read. */
+	uint64_t big_cnt;           /* Big blocks allocated. */
+	uint64_t big_req_bytes;     /* Bytes requested for them. */
+	uint64_t big_bytes;         /* Bytes allocated for them. */
+	int64_t big_pages;          /* Pages allocated less pages freed;
+	                               may be negative if other CPUs
+	                               allocated the pages. */
+	uint64_t realloc_cnt;       /* Calls to realloc() with a block. */
+	uint64_t realloc_inplace;   /* ...that kept the block. */
+};
+static struct stats_cpu stats_cpus[CPU_MAX]; /* Indexed by CPU id. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static size_t desc_take (struct desc *, struct block **, size_t cnt);
+static size_t desc_give (struct desc *, struct block **, size_t cnt);
+static void desc_give_locked (struct desc *, struct block **, size_t cnt,
+		struct list *unused);
+static size_t arenas_free (struct desc *, struct list *unused);
+static void count_big_pages (int64_t page_cnt);
+static void *do_malloc (size_t);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
+	size_t i;
 
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
+	for (i = 0; i < CLASS_CNT; i++) {
 		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+		d->block_size = classes[i].block_size;
+		d->arena_pages = classes[i].arena_pages;
+		d->blocks_per_arena = (PGSIZE * d->arena_pages - sizeof (struct arena))
+			/ d->block_size;
+		ASSERT (d->block_size % 8 == 0);
+		ASSERT (d->blocks_per_arena > 1);
+
+		/* Do not let one CPU pin down more than an arena. */
+		d->cpu_max = d->blocks_per_arena < CPU_BLOCKS
+			? d->blocks_per_arena : CPU_BLOCKS;
 		list_init (&d->free_list);
-		lock_init (&d->lock);
+		spinlock_init (&d->lock);
+		d->arena_cnt = 0;
+		for (int j = 0; j < CPU_MAX; j++) {
+			struct desc_cpu *c = &d->cpus[j];
+
+			spinlock_init (&c->lock);
+			c->cnt = 0;
+			c->alloc_cnt = c->free_cnt = c->hit_cnt = c->req_bytes = 0;
+		}
+	}
+	for (int i = 0; i < CPU_MAX; i++) {
+		struct stats_cpu *s = &stats_cpus[i];
+
+		spinlock_init (&s->lock);
+		s->big_cnt = s->big_req_bytes = s->big_bytes = 0;
+		s->big_pages = 0;
+		s->realloc_cnt = s->realloc_inplace = 0;
 	}
 }
 
+/* Returns this CPU's stack of D's free blocks.  The thread may
+   move to another CPU right after, but each stack has its own
+   lock, so that only costs locality. */
+static struct desc_cpu *
+cpu_of (struct desc *d) {
+	return &d->cpus[this_cpu ()->id];
+}
+
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	void *p = do_malloc (size);
+
+	memprof_alloc (p, size, malloc_block_size (size), MEMPROF_MALLOC,
+			__builtin_return_address (0));
+	return p;
+}
+
+/* Does the work of malloc(), without profiling. */
+static void *
+do_malloc (size_t size) {
+	struct block *batch[CPU_BLOCKS];
+	struct desc_cpu *c;
+	struct stats_cpu *s;
 	struct desc *d;
-	struct block *b;
+	struct block *b = NULL;
 	struct arena *a;
+	size_t n;
 
 	/* A null pointer satisfies a request for 0 bytes. */
 	if (size == 0)
@@ -104,6 +222,14 @@ malloc (size_t size) {
 		if (a == NULL)
 			return NULL;
 
+		s = &stats_cpus[this_cpu ()->id];
+		spinlock_acquire (&s->lock);
+		s->big_cnt++;
+		s->big_req_bytes += size;
+		s->big_bytes += PGSIZE * page_cnt;
+		s->big_pages += page_cnt;
+		spinlock_release (&s->lock);
+
 		/* Initialize the arena to indicate a big block of PAGE_CNT
 		   pages, and return it. */
 		a->magic = ARENA_MAGIC;
@@ -112,35 +238,192 @@ malloc (size_t size) {
 		return a + 1;
 	}
 
-	lock_acquire (&d->lock);
+	/* Fast path: take a block from this CPU's stack. */
+	c = cpu_of (d);
+	spinlock_acquire (&c->lock);
+	if (c->cnt > 0) {
+		b = c->blocks[--c->cnt];
+		c->hit_cnt++;
+		c->alloc_cnt++;
+		c->req_bytes += size;
+	}
+	spinlock_release (&c->lock);
+	if (b != NULL)
+		return b;
 
-	/* If the free list is empty, create a new arena. */
-	if (list_empty (&d->free_list)) {
-		size_t i;
+	/* Refill the stack from the free list, half full. */
+	n = desc_take (d, batch, (d->cpu_max + 1) / 2);
+	if (n == 0)
+		return NULL;
+	b = batch[--n];
+
+	c = cpu_of (d);
+	spinlock_acquire (&c->lock);
+	c->alloc_cnt++;
+	c->req_bytes += size;
+	while (n > 0 && c->cnt < d->cpu_max)
+		c->blocks[c->cnt++] = batch[--n];
+	spinlock_release (&c->lock);
+	if (n > 0)
+		desc_give (d, batch, n);
+	return b;
+}
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
-		if (a == NULL) {
-			lock_release (&d->lock);
-			return NULL;
+/* Obtains a new arena for D from the page allocator and puts
+   all of its blocks in BLOCKS, which it initializes.  Returns
+   the arena, or a null pointer if no pages are available. */
+static struct arena *
+arena_create (struct desc *d, struct list *blocks) {
+	struct arena *a;
+	size_t i;
+
+	a = palloc_get_multiple (0, d->arena_pages);
+	if (a == NULL)
+		return NULL;
+	if (d->arena_pages > 1)
+		palloc_set_owner (a, d->arena_pages, a);
+
+	a->magic = ARENA_MAGIC;
+	a->desc = d;
+	a->free_cnt = d->blocks_per_arena;
+	list_init (blocks);
+	for (i = 0; i < d->blocks_per_arena; i++) {
+		struct block *b = arena_to_block (a, i);
+		list_push_back (blocks, &b->free_elem);
+	}
+	return a;
+}
+
+/* Takes up to CNT blocks off D's free list into BLOCKS[],
+   creating arenas as needed, and returns the number taken. */
+static size_t
+desc_take (struct desc *d, struct block **blocks, size_t cnt) {
+	size_t n = 0;
+
+	spinlock_acquire (&d->lock);
+	while (n < cnt) {
+		struct block *b;
+		struct arena *a;
+
+		/* If the free list is empty, create a new arena without
+		   the lock, then splice its blocks into the free list.
+		   Another CPU may do the same meanwhile; its blocks are
+		   used just as well. */
+		if (list_empty (&d->free_list)) {
+			struct list new_blocks;
+
+			spinlock_release (&d->lock);
+			a = arena_create (d, &new_blocks);
+			spinlock_acquire (&d->lock);
+			if (a == NULL)
+				break;
+			list_splice (list_end (&d->free_list), list_begin (&new_blocks),
+					list_end (&new_blocks));
+			d->arena_cnt++;
+			continue;
 		}
 
-		/* Initialize arena and add its blocks to the free list. */
-		a->magic = ARENA_MAGIC;
-		a->desc = d;
-		a->free_cnt = d->blocks_per_arena;
-		for (i = 0; i < d->blocks_per_arena; i++) {
-			struct block *b = arena_to_block (a, i);
-			list_push_back (&d->free_list, &b->free_elem);
+		/* Get a block from free list. */
+		b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+		a = block_to_arena (b);
+		a->free_cnt--;
+		blocks[n++] = b;
+	}
+	spinlock_release (&d->lock);
+	return n;
+}
+
+/* Returns the CNT blocks in BLOCKS[] to D's free list, freeing
+   arenas that become unused.  Returns the number of pages
+   freed. */
+static size_t
+desc_give (struct desc *d, struct block **blocks, size_t cnt) {
+	struct list unused;
+
+	list_init (&unused);
+	spinlock_acquire (&d->lock);
+	desc_give_locked (d, blocks, cnt, &unused);
+	spinlock_release (&d->lock);
+	return arenas_free (d, &unused);
+}
+
+/* Returns the CNT blocks in BLOCKS[] to D's free list, with D's
+   lock held.  Arenas that become unused are taken off the free
+   list and added to UNUSED, through their first block, for
+   arenas_free() to free once the lock is released. */
+static void
+desc_give_locked (struct desc *d, struct block **blocks, size_t cnt,
+		struct list *unused) {
+	for (size_t n = 0; n < cnt; n++) {
+		struct block *b = blocks[n];
+		struct arena *a = block_to_arena (b);
+
+		/* Add block to free list. */
+		list_push_front (&d->free_list, &b->free_elem);
+
+		/* If the arena is now entirely unused, take it out. */
+		if (++a->free_cnt >= d->blocks_per_arena) {
+			size_t i;
+
+			ASSERT (a->free_cnt == d->blocks_per_arena);
+			for (i = 0; i < d->blocks_per_arena; i++) {
+				struct block *b = arena_to_block (a, i);
+				list_remove (&b->free_elem);
+			}
+			list_push_back (unused, &arena_to_block (a, 0)->free_elem);
+			d->arena_cnt--;
 		}
 	}
+}
 
-	/* Get a block from free list and return it. */
-	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-	a = block_to_arena (b);
-	a->free_cnt--;
-	lock_release (&d->lock);
-	return b;
+/* Gives the arenas of D in UNUSED, as left by desc_give_locked(),
+   back to the page allocator.  Returns the number of pages
+   freed. */
+static size_t
+arenas_free (struct desc *d, struct list *unused) {
+	size_t freed = 0;
+
+	while (!list_empty (unused)) {
+		struct block *b = list_entry (list_pop_front (unused), struct block,
+				free_elem);
+
+		palloc_free_multiple (block_to_arena (b), d->arena_pages);
+		freed += d->arena_pages;
+	}
+	return freed;
+}
+
+/* Moves the blocks in every CPU's stacks back to the free lists,
+   so that arenas they kept in use can be freed.  Called by the
+   page allocator when it runs out of pages, which it is never
+   asked for with a descriptor's lock held.  Returns the number
+   of pages freed. */
+size_t
+malloc_reclaim (void) {
+	struct block *batch[CPU_BLOCKS];
+	struct desc *d;
+	size_t freed = 0;
+
+	for (d = descs; d < descs + desc_cnt; d++) {
+		struct list unused;
+
+		list_init (&unused);
+		spinlock_acquire (&d->lock);
+		for (int i = 0; i < cpu_cnt; i++) {
+			struct desc_cpu *c = &d->cpus[i];
+			size_t n;
+
+			spinlock_acquire (&c->lock);
+			n = c->cnt;
+			memcpy (batch, c->blocks, n * sizeof *c->blocks);
+			c->cnt = 0;
+			spinlock_release (&c->lock);
+			desc_give_locked (d, batch, n, &unused);
+		}
+		spinlock_release (&d->lock);
+		freed += arenas_free (d, &unused);
+	}
+	return freed;
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -156,13 +439,29 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = do_malloc (size);
 	if (p != NULL)
 		memset (p, 0, size);
+	memprof_alloc (p, size, malloc_block_size (size), MEMPROF_MALLOC,
+			__builtin_return_address (0));
 
 	return p;
 }
 
+/* Returns the number of bytes of memory, counting its share of
+   arena overhead, that malloc() uses for a SIZE-byte request. */
+size_t
+malloc_block_size (size_t size) {
+	struct desc *d;
+
+	if (size == 0)
+		return 0;
+	for (d = descs; d < descs + desc_cnt; d++)
+		if (d->block_size >= size)
+			return PGSIZE * d->arena_pages / d->blocks_per_arena;
+	return PGSIZE * DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE);
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) {
@@ -173,24 +472,85 @@ block_size (void *block) {
 	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
+/* Returns true if a block of OLD_SIZE bytes can keep serving as
+   a NEW_SIZE-byte block: it must be big enough, and not so big
+   that moving to a smaller size class would save more than half
+   of it. */
+static bool
+fits_in_place (size_t old_size, size_t new_size) {
+	return new_size <= old_size && new_size > old_size / 2;
+}
+
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
    moving it in the process.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
-   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK).
+
+   The block stays where it is if its size class, or the last
+   page of a big block, has room for NEW_SIZE bytes.  A big block
+   that shrinks gives its unneeded trailing pages back, and one
+   that grows takes the pages right after it if they are free. */
 void *
 realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
-	} else {
-		void *new_block = malloc (new_size);
-		if (old_block != NULL && new_block != NULL) {
-			size_t old_size = block_size (old_block);
+	} else if (old_block == NULL) {
+		void *p = do_malloc (new_size);
+
+		memprof_alloc (p, new_size, malloc_block_size (new_size),
+				MEMPROF_MALLOC, __builtin_return_address (0));
+		return p;
+	}
+	else {
+		struct arena *a = block_to_arena (old_block);
+		size_t old_size = block_size (old_block);
+		struct stats_cpu *s;
+		bool inplace = false;
+		void *new_block;
+
+		if (a->desc != NULL)
+			inplace = fits_in_place (old_size, new_size);
+		else if (new_size > descs[desc_cnt - 1].block_size) {
+			/* Big block stays big: trim any whole pages, or grow
+			   into the pages that follow. */
+			size_t page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+
+			if (page_cnt < a->free_cnt) {
+				palloc_free_multiple ((uint8_t *) a + PGSIZE * page_cnt,
+						a->free_cnt - page_cnt);
+				count_big_pages (-(int64_t) (a->free_cnt - page_cnt));
+				a->free_cnt = page_cnt;
+				inplace = true;
+			} else if (palloc_extend (a, a->free_cnt, page_cnt)) {
+				count_big_pages (page_cnt - a->free_cnt);
+				a->free_cnt = page_cnt;
+				inplace = true;
+			}
+		}
+
+		s = &stats_cpus[this_cpu ()->id];
+		spinlock_acquire (&s->lock);
+		s->realloc_cnt++;
+		if (inplace)
+			s->realloc_inplace++;
+		spinlock_release (&s->lock);
+		if (inplace) {
+			memprof_free (old_block);
+			memprof_alloc (old_block, new_size, block_size (old_block),
+					MEMPROF_MALLOC, __builtin_return_address (0));
+			return old_block;
+		}
+
+		new_block = do_malloc (new_size);
+		if (new_block != NULL) {
 			size_t min_size = new_size < old_size ? new_size : old_size;
 			memcpy (new_block, old_block, min_size);
 			free (old_block);
+			memprof_alloc (new_block, new_size, malloc_block_size (new_size),
+					MEMPROF_MALLOC, __builtin_return_address (0));
 		}
 		return new_block;
 	}
@@ -200,6 +560,7 @@ realloc (void *old_block, size_t new_size) {
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) {
+	memprof_free (p);
 	if (p != NULL) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
@@ -207,42 +568,120 @@ free (void *p) {
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
+			struct block *batch[CPU_BLOCKS];
+			struct desc_cpu *c;
+			size_t n = 0;
 
 #ifndef NDEBUG
 			/* Clear the block to help detect use-after-free bugs. */
 			memset (b, 0xcc, d->block_size);
 #endif
 
-			lock_acquire (&d->lock);
-
-			/* Add block to free list. */
-			list_push_front (&d->free_list, &b->free_elem);
-
-			/* If the arena is now entirely unused, free it. */
-			if (++a->free_cnt >= d->blocks_per_arena) {
-				size_t i;
-
-				ASSERT (a->free_cnt == d->blocks_per_arena);
-				for (i = 0; i < d->blocks_per_arena; i++) {
-					struct block *b = arena_to_block (a, i);
-					list_remove (&b->free_elem);
-				}
-				palloc_free_page (a);
+			/* Push it on this CPU's stack, first moving the older
+			   half back to the free list if the stack is full. */
+			c = cpu_of (d);
+			spinlock_acquire (&c->lock);
+			if (c->cnt >= d->cpu_max) {
+				n = d->cpu_max / 2;
+				memcpy (batch, c->blocks, n * sizeof *c->blocks);
+				c->cnt -= n;
+				memmove (c->blocks, c->blocks + n, c->cnt * sizeof *c->blocks);
 			}
-
-			lock_release (&d->lock);
+			c->blocks[c->cnt++] = b;
+			c->free_cnt++;
+			spinlock_release (&c->lock);
+			if (n > 0)
+				desc_give (d, batch, n);
 		} else {
 			/* It's a big block.  Free its pages. */
+			count_big_pages (-(int64_t) a->free_cnt);
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Adds PAGE_CNT, negative for pages freed, to this CPU's count
+   of pages in big blocks. */
+static void
+count_big_pages (int64_t page_cnt) {
+	struct stats_cpu *s = &stats_cpus[this_cpu ()->id];
+
+	spinlock_acquire (&s->lock);
+	s->big_pages += page_cnt;
+	spinlock_release (&s->lock);
+}
+
+/* Returns the share of BYTES that were asked for, REQ, in tenths
+   of a percent. */
+static unsigned
+permille (uint64_t req, uint64_t bytes) {
+	return bytes != 0 ? req * 1000 / bytes : 1000;
+}
+
+/* Prints, for each size class, the arenas and blocks in use and
+   the internal fragmentation of all blocks handed out so far:
+   the share of their bytes that callers did not ask for. */
+void
+malloc_print_stats (void) {
+	uint64_t big_cnt = 0, big_req_bytes = 0, big_bytes = 0;
+	uint64_t realloc_cnt = 0, realloc_inplace = 0;
+	int64_t big_pages = 0;
+	struct desc *d;
+	unsigned waste;
+
+	printf ("malloc: class  arenas  in use   allocs  cached  waste\n");
+	for (d = descs; d < descs + desc_cnt; d++) {
+		uint64_t allocs = 0, frees = 0, hits = 0, req_bytes = 0;
+
+		for (int i = 0; i < cpu_cnt; i++) {
+			struct desc_cpu *c = &d->cpus[i];
+
+			spinlock_acquire (&c->lock);
+			allocs += c->alloc_cnt;
+			frees += c->free_cnt;
+			hits += c->hit_cnt;
+			req_bytes += c->req_bytes;
+			spinlock_release (&c->lock);
+		}
+		if (allocs == 0)
+			continue;
+		waste = 1000 - permille (req_bytes, allocs * d->block_size);
+		printf ("malloc: %5zu %7zu %7llu %8llu %6u%% %3u.%u%%\n",
+				d->block_size, d->arena_cnt,
+				(unsigned long long) (allocs - frees),
+				(unsigned long long) allocs,
+				(unsigned) (hits * 100 / allocs), waste / 10, waste % 10);
+	}
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		struct stats_cpu *s = &stats_cpus[i];
+
+		spinlock_acquire (&s->lock);
+		big_cnt += s->big_cnt;
+		big_req_bytes += s->big_req_bytes;
+		big_bytes += s->big_bytes;
+		big_pages += s->big_pages;
+		realloc_cnt += s->realloc_cnt;
+		realloc_inplace += s->realloc_inplace;
+		spinlock_release (&s->lock);
+	}
+	waste = 1000 - permille (big_req_bytes, big_bytes);
+	printf ("malloc: big blocks: %lld pages in use, %llu allocs, "
+			"%u.%u%% waste\n", (long long) big_pages,
+			(unsigned long long) big_cnt, waste / 10, waste % 10);
+	printf ("malloc: realloc: %llu of %llu calls in place\n",
+			(unsigned long long) realloc_inplace,
+			(unsigned long long) realloc_cnt);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a = palloc_get_owner (b);
+
+	if (a == NULL)
+		a = pg_round_down (b);
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,7 +689,8 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| ((uint8_t *) b - (uint8_t *) a - sizeof *a)
+			% a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
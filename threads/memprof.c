@@ -0,0 +1,229 @@
+#include "threads/memprof.h"
+#ifdef KMEM_PROFILE
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Kernel memory allocation profiler.
+
+   Every allocation from malloc() and the page allocator is
+   charged to its call site, the return address of the allocating
+   call, together with the size class that actually served it.
+   A table of sites keeps allocation counts and live and peak
+   bytes per (site, size class) pair, and a table of live
+   allocations maps each block back to its site so that frees can
+   be credited.  Both are fixed-size open-addressed hash tables
+   with linear probing, allocated once at boot, so the profiler
+   itself never allocates.  Allocations that do not fit are only
+   counted.
+
+   The report lists the sites holding the most live bytes, which
+   after a leak or an out-of-memory failure points at the
+   culprit.  Addresses can be turned into function names with the
+   `backtrace' utility. */
+
+/* Table sizes.  Both must be powers of 2. */
+#define SITE_CNT 1024
+#define LIVE_CNT 16384
+
+/* A call site and size class. */
+struct site {
+	const void *pc;             /* Return address; null if slot free. */
+	size_t class_size;          /* Bytes actually allocated per call. */
+	enum memprof_kind kind;
+	uint64_t alloc_cnt;         /* Allocations made. */
+	uint64_t free_cnt;          /* Of those, freed. */
+	size_t live_bytes;          /* Bytes requested and not freed. */
+	size_t peak_bytes;          /* Highest LIVE_BYTES. */
+};
+
+/* A live allocation. */
+struct live {
+	const void *ptr;            /* Block; null if slot free. */
+	size_t size;                /* Bytes requested. */
+	struct site *site;          /* Charged site. */
+};
+
+static struct spinlock memprof_lock;
+static struct site *sites;      /* SITE_CNT entries. */
+static struct live *lives;      /* LIVE_CNT entries. */
+static bool enabled;            /* Tables ready? */
+static uint64_t lost_cnt;       /* Allocations not tracked. */
+
+/* Returns a hash of pointer P. */
+static size_t
+hash_ptr (const void *p) {
+	uint64_t x = (uint64_t) p;
+
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/* Allocates the profiler's tables.  Must be called after
+   palloc_init(); allocations made before are not tracked. */
+void
+memprof_init (void) {
+	size_t site_pages = DIV_ROUND_UP (SITE_CNT * sizeof *sites, PGSIZE);
+	size_t live_pages = DIV_ROUND_UP (LIVE_CNT * sizeof *lives, PGSIZE);
+
+	spinlock_init (&memprof_lock);
+	sites = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, site_pages);
+	lives = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, live_pages);
+	enabled = true;
+}
+
+/* Returns the entry for PC and CLASS_SIZE in the site table,
+   claiming a free slot if there is none yet, or a null pointer
+   if the table is full. */
+static struct site *
+site_lookup (const void *pc, size_t class_size, enum memprof_kind kind) {
+	size_t i = hash_ptr ((const uint8_t *) pc + class_size);
+
+	for (size_t n = 0; n < SITE_CNT; n++, i++) {
+		struct site *s = &sites[i % SITE_CNT];
+
+		if (s->pc == pc && s->class_size == class_size && s->kind == kind)
+			return s;
+		if (s->pc == NULL) {
+			s->pc = pc;
+			s->class_size = class_size;
+			s->kind = kind;
+			return s;
+		}
+	}
+	return NULL;
+}
+
+/* Records that SIZE bytes at P, taking CLASS_SIZE bytes of
+   memory, were allocated by the call returning to SITE. */
+void
+memprof_alloc (const void *p, size_t size, size_t class_size,
+		enum memprof_kind kind, const void *site) {
+	struct site *s;
+	size_t i, n;
+
+	if (!enabled || p == NULL)
+		return;
+
+	spinlock_acquire (&memprof_lock);
+	s = site_lookup (site, class_size, kind);
+	if (s == NULL)
+		goto lost;
+	i = hash_ptr (p) % LIVE_CNT;
+	for (n = 0; lives[i].ptr != NULL; n++, i = (i + 1) % LIVE_CNT)
+		if (n == LIVE_CNT)
+			goto lost;
+	lives[i] = (struct live) {p, size, s};
+
+	s->alloc_cnt++;
+	s->live_bytes += size;
+	if (s->live_bytes > s->peak_bytes)
+		s->peak_bytes = s->live_bytes;
+	spinlock_release (&memprof_lock);
+	return;
+
+lost:
+	lost_cnt++;
+	spinlock_release (&memprof_lock);
+}
+
+/* Records that the allocation at P was freed.  Does nothing if P
+   is not being tracked. */
+void
+memprof_free (const void *p) {
+	size_t i, j, n;
+
+	if (!enabled || p == NULL)
+		return;
+
+	spinlock_acquire (&memprof_lock);
+	i = hash_ptr (p) % LIVE_CNT;
+	for (n = 0; lives[i].ptr != p; n++, i = (i + 1) % LIVE_CNT)
+		if (lives[i].ptr == NULL || n == LIVE_CNT) {
+			spinlock_release (&memprof_lock);
+			return;
+		}
+
+	lives[i].site->free_cnt++;
+	lives[i].site->live_bytes -= lives[i].size;
+
+	/* Delete by shifting later entries of the probe run back, so
+	   that lookups never need tombstones. */
+	for (j = (i + 1) % LIVE_CNT; lives[j].ptr != NULL; j = (j + 1) % LIVE_CNT) {
+		size_t home = hash_ptr (lives[j].ptr) % LIVE_CNT;
+
+		/* Move J to the hole at I unless its home slot lies
+		   cyclically in (I, J]. */
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		lives[i] = lives[j];
+		i = j;
+	}
+	lives[i].ptr = NULL;
+	spinlock_release (&memprof_lock);
+}
+
+/* Prints the TOP_CNT call sites with the most live bytes, at
+   most MEMPROF_TOP. */
+void
+memprof_print (size_t top_cnt) {
+	static const char *kinds[] = {"malloc", "page"};
+	struct site top[MEMPROF_TOP];
+	struct site *last = NULL;
+	size_t live_total = 0;
+	uint64_t lost;
+	size_t n;
+
+	if (!enabled)
+		return;
+	if (top_cnt > MEMPROF_TOP)
+		top_cnt = MEMPROF_TOP;
+
+	/* Copy the report out, because printing may sleep.  Selects
+	   by repeated scans, in order of live bytes and then of table
+	   position: the table is small and this is not a hot path. */
+	spinlock_acquire (&memprof_lock);
+	for (size_t i = 0; i < SITE_CNT; i++)
+		live_total += sites[i].live_bytes;
+	lost = lost_cnt;
+	for (n = 0; n < top_cnt; n++) {
+		struct site *best = NULL;
+
+		for (size_t i = 0; i < SITE_CNT; i++) {
+			struct site *s = &sites[i];
+
+			if (s->pc == NULL || s->live_bytes == 0)
+				continue;
+			if (last != NULL
+					&& (s->live_bytes > last->live_bytes
+						|| (s->live_bytes == last->live_bytes && s <= last)))
+				continue;
+			if (best == NULL || s->live_bytes > best->live_bytes)
+				best = s;
+		}
+		if (best == NULL)
+			break;
+		top[n] = *best;
+		last = best;
+	}
+	spinlock_release (&memprof_lock);
+
+	printf ("Memory profile: %zu bytes live, %llu allocations untracked\n",
+			live_total, (unsigned long long) lost);
+	printf ("%18s %6s %7s %10s %10s %8s %8s\n", "site", "kind", "class",
+			"live", "peak", "allocs", "frees");
+	for (size_t i = 0; i < n; i++)
+		printf ("%18p %6s %7zu %10zu %10zu %8llu %8llu\n",
+				top[i].pc, kinds[top[i].kind], top[i].class_size,
+				top[i].live_bytes, top[i].peak_bytes,
+				(unsigned long long) top[i].alloc_cnt,
+				(unsigned long long) top[i].free_cnt);
+}
+#endif /* KMEM_PROFILE */
@@ -2,13 +2,19 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/memprof.h"
+#include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -24,15 +30,85 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  Free memory is kept as blocks of 2**ORDER pages,
+   each aligned to its size relative to the pool base, on one
+   free list per order.  An allocation takes a block of the
+   smallest sufficient order, splitting a larger one if needed,
+   and gives back the pages beyond the request; a free merges
+   each block with its buddy, the other half of the next larger
+   block, for as long as the buddy is free too.  Both take
+   O(log n) steps in the pool size.
+
+   Single pages, by far the most common request, are served from
+   a per-CPU cache of free pages ("magazine") in front of each
+   pool.  A CPU's cache is refilled from the pool, and drained
+   back into it, CACHE_BATCH pages at a time, so most single-page
+   allocations and frees take only the cache's own spinlock,
+   which no other CPU contends for, and not the pool lock.
+
+   PAL_ZERO requests for a single page are served from a list of
+   free pages that a low-priority kernel thread zeroed ahead of
+   time, while the CPU had nothing better to do, so they do not
+   pay for the memset. */
+
+/* Number of block orders.  The largest block has
+   2**(PALLOC_ORDERS - 1) pages. */
+#define PALLOC_ORDERS 20
+
+/* Buddy allocator state of one page. */
+struct page_info {
+	struct list_elem elem;          /* In a free list, if ORDER >= 0. */
+	int8_t order;                   /* Order of the free block starting
+	                                   here, or -1 if none does. */
+	void *owner;                    /* Set by palloc_set_owner(). */
+};
+
+/* Maximum number of pages in a per-CPU page cache, and number of
+   pages moved between a cache and its pool at once. */
+#define CACHE_SIZE 32
+#define CACHE_BATCH 16
+
+/* Number of pre-zeroed pages the zeroing thread keeps for each
+   pool, and the count below which taking one wakes it up. */
+#define ZERO_TARGET 64
+#define ZERO_LOW 32
+
+/* Per-CPU cache of free pages from one pool.  Pages in a cache
+   count as allocated as far as the pool is concerned. */
+struct page_cache {
+	struct spinlock lock;           /* Taken by other CPUs only to drain. */
+	size_t cnt;                     /* # of pages in PAGES. */
+	void *pages[CACHE_SIZE];        /* Free pages, most recently freed last. */
+	unsigned long long gets;        /* # of single-page allocations. */
+	unsigned long long get_hits;    /* ...served from PAGES. */
+	unsigned long long puts;        /* # of single-page frees. */
+	unsigned long long put_hits;    /* ...kept in PAGES. */
+};
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
+	struct adaptive_lock lock;      /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct page_info *pages;        /* One per page. */
+	struct list free_lists[PALLOC_ORDERS]; /* Free blocks, by order. */
+	size_t free_cnt;                /* # of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	struct page_cache caches[CPU_MAX]; /* Indexed by CPU id. */
+
+	struct spinlock zero_lock;      /* Protects the members below. */
+	struct list zeroed;             /* Zeroed free pages' page_infos. */
+	size_t zeroed_cnt;              /* # of pages in ZEROED. */
+	unsigned long long zero_gets;   /* # of PAL_ZERO single-page gets. */
+	unsigned long long zero_hits;   /* ...served from ZEROED. */
 };
 
+/* Upped to make the zeroing thread top up the zeroed lists. */
+static struct semaphore zero_wanted;
+static bool zeroing_started;
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
@@ -42,6 +118,18 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void *get_multiple (enum palloc_flags, size_t page_cnt);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free_range (struct pool *, size_t page_idx,
+		size_t page_cnt);
+static void buddy_take_range (struct pool *, size_t page_idx,
+		size_t page_cnt);
+static void *pool_get (struct pool *, size_t page_cnt);
+static void pool_put (struct pool *, void *pages, size_t page_cnt);
+static void *cache_get (struct pool *);
+static void cache_put (struct pool *, void *page);
+static bool pool_drain (struct pool *);
+static void *zeroed_get (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -224,11 +312,13 @@ split:
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				buddy_free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -261,17 +351,40 @@ palloc_init (void) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
-	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	void *pages = get_multiple (flags, page_cnt);
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	memprof_alloc (pages, PGSIZE * page_cnt, PGSIZE * page_cnt, MEMPROF_PAGE,
+			__builtin_return_address (0));
+	return pages;
+}
+
+/* Does the work of palloc_get_multiple(), without profiling. */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 0)
+		return NULL;
+
+	if (page_cnt == 1 && (flags & PAL_ZERO)) {
+		pages = zeroed_get (pool);
+		if (pages != NULL)
+			return pages;
+	}
+
+	pages = page_cnt == 1 ? cache_get (pool) : pool_get (pool, page_cnt);
+
+	/* Free pages may be sitting in caches or zeroed lists, or,
+	   for the kernel pool, in the object caches' empty slabs and
+	   in arenas kept alive by malloc()'s per-CPU stacks. */
+	if (pages == NULL && pool_drain (pool))
+		pages = pool_get (pool, page_cnt);
+	if (pages == NULL && pool == &kernel_pool
+			&& kmem_reclaim () + malloc_reclaim () > 0) {
+		pool_drain (pool);
+		pages = pool_get (pool, page_cnt);
+	}
 
 	if (pages) {
 		if (flags & PAL_ZERO)
@@ -293,18 +406,22 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_page (enum palloc_flags flags) {
-	return palloc_get_multiple (flags, 1);
+	void *page = get_multiple (flags, 1);
+
+	memprof_alloc (page, PGSIZE, PGSIZE, MEMPROF_PAGE,
+			__builtin_return_address (0));
+	return page;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
-	size_t page_idx;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
 		return;
+	memprof_free (pages);
 
 	if (page_from_pool (&kernel_pool, pages))
 		pool = &kernel_pool;
@@ -313,13 +430,15 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	else
 		NOT_REACHED ();
 
-	page_idx = pg_no (pages) - pg_no (pool->base);
-
+	for (size_t i = 0; i < page_cnt; i++)
+		pool->pages[pg_no (pages) - pg_no (pool->base) + i].owner = NULL;
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1)
+		cache_put (pool, pages);
+	else
+		pool_put (pool, pages, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +447,148 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Tries to grow the allocation of PAGE_CNT pages at PAGES to
+   NEW_CNT pages without moving it, by taking the pages right
+   after it.  Returns true if successful, false if any of those
+   pages is in use or beyond the end of the pool.  Pages sitting
+   in a per-CPU cache count as in use. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt) {
+	struct pool *pool;
+	size_t page_idx;
+	bool success = false;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (new_cnt >= page_cnt);
+	if (new_cnt == page_cnt)
+		return true;
+
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+	page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+
+	adaptive_lock_acquire (&pool->lock);
+	if (page_idx + (new_cnt - page_cnt) <= bitmap_size (pool->used_map)
+			&& bitmap_none (pool->used_map, page_idx, new_cnt - page_cnt)) {
+		buddy_take_range (pool, page_idx, new_cnt - page_cnt);
+		bitmap_set_multiple (pool->used_map, page_idx, new_cnt - page_cnt,
+				true);
+		success = true;
+	}
+	adaptive_lock_release (&pool->lock);
+	return success;
+}
+
+/* Returns the page_info of PAGE, or a null pointer if PAGE is not
+   in either pool. */
+static struct page_info *
+page_info_of (const void *page) {
+	struct pool *pool;
+
+	if (page_from_pool (&kernel_pool, (void *) page))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, (void *) page))
+		pool = &user_pool;
+	else
+		return NULL;
+	return &pool->pages[pg_no (page) - pg_no (pool->base)];
+}
+
+/* Records OWNER as the owner of each of the PAGE_CNT allocated
+   pages starting at PAGES, for palloc_get_owner().  The record is
+   cleared when the pages are freed.  Lets a user of multi-page
+   blocks find a block's header from any page in it. */
+void
+palloc_set_owner (void *pages, size_t page_cnt, void *owner) {
+	ASSERT (pg_ofs (pages) == 0);
+
+	for (size_t i = 0; i < page_cnt; i++) {
+		struct page_info *info = page_info_of ((uint8_t *) pages + i * PGSIZE);
+
+		ASSERT (info != NULL);
+		info->owner = owner;
+	}
+}
+
+/* Returns the owner recorded for the page containing VADDR by
+   palloc_set_owner(), or a null pointer if there is none. */
+void *
+palloc_get_owner (const void *vaddr) {
+	struct page_info *info = page_info_of (pg_round_down (vaddr));
+
+	return info != NULL ? info->owner : NULL;
+}
+
+/* Returns all pages in per-CPU caches and zeroed lists to their
+   pools, so that they can be merged into larger blocks. */
+void
+palloc_drain_caches (void) {
+	pool_drain (&kernel_pool);
+	pool_drain (&user_pool);
+}
+
+/* Prints the hit rates of the per-CPU caches of POOL, named
+   NAME. */
+static void
+print_cache_stats (const char *name, struct pool *pool) {
+	unsigned long long gets = 0, get_hits = 0, puts = 0, put_hits = 0;
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		struct page_cache *c = &pool->caches[i];
+
+		gets += c->gets;
+		get_hits += c->get_hits;
+		puts += c->puts;
+		put_hits += c->put_hits;
+	}
+	printf ("Page cache: %s pool: %llu of %llu gets hit, "
+			"%llu of %llu frees hit\n", name, get_hits, gets, put_hits, puts);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	print_cache_stats ("kernel", &kernel_pool);
+	print_cache_stats ("user", &user_pool);
+	printf ("Page zeroing: %llu of %llu kernel, %llu of %llu user "
+			"zeroed pages ready\n",
+			kernel_pool.zero_hits, kernel_pool.zero_gets,
+			user_pool.zero_hits, user_pool.zero_gets);
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool.  Pages held in
+   per-CPU caches are not counted. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+	return pool->free_cnt;
+}
+
+/* Returns the number of pages in the largest run of free pages
+   that palloc_get_multiple() could currently hand out at once
+   from the pool selected by FLAGS, as palloc_free_cnt() does.
+   The ratio of the two measures the pool's fragmentation. */
+size_t
+palloc_largest_free (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t largest = 0;
+
+	adaptive_lock_acquire (&pool->lock);
+	for (int order = PALLOC_ORDERS - 1; order >= 0; order--)
+		if (!list_empty (&pool->free_lists[order])) {
+			largest = (size_t) 1 << order;
+			break;
+		}
+	adaptive_lock_release (&pool->lock);
+	return largest;
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -336,15 +597,31 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t info_pages = ROUND_UP (pgcnt * sizeof *p->pages, PGSIZE);
 
-	lock_init(&p->lock);
+	adaptive_lock_init (&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	p->pages = *bm_base + bm_pages;
 	p->base = (void *) start;
+	for (int order = 0; order < PALLOC_ORDERS; order++)
+		list_init (&p->free_lists[order]);
+	p->free_cnt = 0;
+	for (int i = 0; i < CPU_MAX; i++) {
+		spinlock_init (&p->caches[i].lock);
+		p->caches[i].cnt = 0;
+	}
+	spinlock_init (&p->zero_lock);
+	list_init (&p->zeroed);
+	p->zeroed_cnt = 0;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
+	for (uint64_t i = 0; i < pgcnt; i++) {
+		p->pages[i].order = -1;
+		p->pages[i].owner = NULL;
+	}
 
-	*bm_base += bm_pages;
+	*bm_base += bm_pages + info_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -356,3 +633,386 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Takes PAGE_CNT contiguous pages out of POOL and returns the
+   first, or a null pointer if POOL has no such run free. */
+static void *
+pool_get (struct pool *pool, size_t page_cnt) {
+	size_t page_idx;
+
+	adaptive_lock_acquire (&pool->lock);
+	page_idx = buddy_alloc (pool, page_cnt);
+	if (page_idx != BITMAP_ERROR) {
+		ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+	}
+	adaptive_lock_release (&pool->lock);
+
+	return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Takes up to CNT single pages out of POOL into PAGES[], holding
+   the pool lock only once.  Returns the number taken. */
+static size_t
+pool_get_batch (struct pool *pool, void **pages, size_t cnt) {
+	size_t i;
+
+	adaptive_lock_acquire (&pool->lock);
+	for (i = 0; i < cnt; i++) {
+		size_t page_idx = buddy_alloc (pool, 1);
+
+		if (page_idx == BITMAP_ERROR)
+			break;
+		ASSERT (!bitmap_test (pool->used_map, page_idx));
+		bitmap_mark (pool->used_map, page_idx);
+		pages[i] = pool->base + PGSIZE * page_idx;
+	}
+	adaptive_lock_release (&pool->lock);
+	return i;
+}
+
+/* Returns the PAGE_CNT pages starting at PAGES to POOL. */
+static void
+pool_put (struct pool *pool, void *pages, size_t page_cnt) {
+	size_t page_idx = pg_no (pages) - pg_no (pool->base);
+
+	adaptive_lock_acquire (&pool->lock);
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_free_range (pool, page_idx, page_cnt);
+	adaptive_lock_release (&pool->lock);
+}
+
+/* Returns the CNT single pages in PAGES[] to POOL, holding the
+   pool lock only once. */
+static void
+pool_put_batch (struct pool *pool, void **pages, size_t cnt) {
+	adaptive_lock_acquire (&pool->lock);
+	for (size_t i = 0; i < cnt; i++) {
+		size_t page_idx = pg_no (pages[i]) - pg_no (pool->base);
+
+		ASSERT (bitmap_test (pool->used_map, page_idx));
+		bitmap_reset (pool->used_map, page_idx);
+		buddy_free_range (pool, page_idx, 1);
+	}
+	adaptive_lock_release (&pool->lock);
+}
+
+/* Per-CPU page caches. */
+
+/* Returns this CPU's cache of POOL's pages.  The CPU may change
+   right after unless interrupts are off, but each cache has its
+   own lock, so using another CPU's cache is merely slower. */
+static struct page_cache *
+cache_of (struct pool *pool) {
+	return &pool->caches[this_cpu ()->id];
+}
+
+/* Takes a free page from this CPU's cache of POOL's pages,
+   refilling the cache from POOL if it is empty.  Returns a null
+   pointer if POOL has no free pages either. */
+static void *
+cache_get (struct pool *pool) {
+	void *batch[CACHE_BATCH];
+	struct page_cache *c = cache_of (pool);
+	void *page = NULL;
+	size_t n;
+
+	spinlock_acquire (&c->lock);
+	c->gets++;
+	if (c->cnt > 0) {
+		c->get_hits++;
+		page = c->pages[--c->cnt];
+	}
+	spinlock_release (&c->lock);
+	if (page != NULL)
+		return page;
+
+	/* Refill without the spinlock held, because the pool lock may
+	   block. */
+	n = pool_get_batch (pool, batch, CACHE_BATCH);
+	if (n == 0)
+		return NULL;
+	page = batch[--n];
+
+	c = cache_of (pool);
+	spinlock_acquire (&c->lock);
+	while (n > 0 && c->cnt < CACHE_SIZE)
+		c->pages[c->cnt++] = batch[--n];
+	spinlock_release (&c->lock);
+	if (n > 0)
+		pool_put_batch (pool, batch, n);
+	return page;
+}
+
+/* Puts PAGE, from POOL, in this CPU's cache of POOL's pages.  If
+   the cache is full, first returns its CACHE_BATCH least recently
+   freed pages, the ones least likely to still be in the CPU's
+   data cache, to POOL. */
+static void
+cache_put (struct pool *pool, void *page) {
+	void *batch[CACHE_BATCH];
+	struct page_cache *c = cache_of (pool);
+	size_t n = 0;
+
+	spinlock_acquire (&c->lock);
+	c->puts++;
+	if (c->cnt < CACHE_SIZE)
+		c->put_hits++;
+	else {
+		n = CACHE_BATCH;
+		memcpy (batch, c->pages, sizeof batch);
+		c->cnt -= n;
+		memmove (c->pages, c->pages + n, c->cnt * sizeof *c->pages);
+	}
+	c->pages[c->cnt++] = page;
+	spinlock_release (&c->lock);
+	if (n > 0)
+		pool_put_batch (pool, batch, n);
+}
+
+/* Returns the pages in every CPU's cache of POOL's pages, and in
+   POOL's zeroed list, to POOL.  Returns true if there were any. */
+static bool
+pool_drain (struct pool *pool) {
+	void *batch[CACHE_SIZE];
+	bool drained = false;
+	size_t n;
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		struct page_cache *c = &pool->caches[i];
+		size_t n;
+
+		spinlock_acquire (&c->lock);
+		n = c->cnt;
+		memcpy (batch, c->pages, n * sizeof *c->pages);
+		c->cnt = 0;
+		spinlock_release (&c->lock);
+		if (n > 0) {
+			pool_put_batch (pool, batch, n);
+			drained = true;
+		}
+	}
+
+	do {
+		spinlock_acquire (&pool->zero_lock);
+		for (n = 0; n < CACHE_SIZE && !list_empty (&pool->zeroed); n++) {
+			struct page_info *info = list_entry (list_pop_front (&pool->zeroed),
+					struct page_info, elem);
+			batch[n] = pool->base + PGSIZE * (info - pool->pages);
+		}
+		pool->zeroed_cnt -= n;
+		spinlock_release (&pool->zero_lock);
+		if (n > 0) {
+			pool_put_batch (pool, batch, n);
+			drained = true;
+		}
+	} while (n == CACHE_SIZE);
+	return drained;
+}
+
+/* Page zeroing. */
+
+/* Takes a page off POOL's list of zeroed pages, waking up the
+   zeroing thread if the list runs low.  Returns a null pointer
+   if the list is empty. */
+static void *
+zeroed_get (struct pool *pool) {
+	struct page_info *info = NULL;
+	bool low;
+
+	spinlock_acquire (&pool->zero_lock);
+	pool->zero_gets++;
+	if (!list_empty (&pool->zeroed)) {
+		info = list_entry (list_pop_front (&pool->zeroed), struct page_info,
+				elem);
+		pool->zeroed_cnt--;
+		pool->zero_hits++;
+	}
+	low = pool->zeroed_cnt < ZERO_LOW;
+	spinlock_release (&pool->zero_lock);
+
+	if (low && zeroing_started)
+		sema_up (&zero_wanted);
+	return info != NULL ? pool->base + PGSIZE * (info - pool->pages) : NULL;
+}
+
+/* Zeroes a free page of POOL and adds it to POOL's zeroed list,
+   unless the list already holds ZERO_TARGET pages or POOL has no
+   free page.  Returns true if it added one. */
+static bool
+zero_one (struct pool *pool) {
+	void *page;
+
+	if (pool->zeroed_cnt >= ZERO_TARGET)
+		return false;
+	page = pool_get (pool, 1);
+	if (page == NULL)
+		return false;
+
+	memset (page, 0, PGSIZE);
+
+	spinlock_acquire (&pool->zero_lock);
+	list_push_back (&pool->zeroed,
+			&pool->pages[pg_no (page) - pg_no (pool->base)].elem);
+	pool->zeroed_cnt++;
+	spinlock_release (&pool->zero_lock);
+	return true;
+}
+
+/* Zeroing thread.  It runs at PRI_MIN, so it only gets the CPU
+   when no other thread wants it, and keeps both pools' zeroed
+   lists topped up. */
+static void
+zero_thread (void *aux UNUSED) {
+	if (thread_mlfqs)
+		thread_set_nice (20);
+
+	for (;;) {
+		while (zero_one (&kernel_pool) | zero_one (&user_pool))
+			continue;
+		sema_down (&zero_wanted);
+	}
+}
+
+/* Starts the thread that zeroes free pages in the background.
+   Until this is called, every PAL_ZERO request is zeroed on the
+   spot. */
+void
+palloc_zero_start (void) {
+	sema_init (&zero_wanted, 0);
+	if (thread_create ("pagezero", PRI_MIN, zero_thread, NULL) == TID_ERROR)
+		PANIC ("cannot start page zeroing thread");
+	zeroing_started = true;
+}
+
+/* Buddy allocator. */
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_for (size_t page_cnt) {
+	int order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX in P to the
+   free list for ORDER. */
+static void
+block_push (struct pool *p, size_t page_idx, int order) {
+	p->pages[page_idx].order = order;
+	list_push_front (&p->free_lists[order], &p->pages[page_idx].elem);
+}
+
+/* Removes the free block at PAGE_IDX in P from its free list. */
+static void
+block_remove (struct pool *p, size_t page_idx) {
+	ASSERT (p->pages[page_idx].order >= 0);
+	list_remove (&p->pages[page_idx].elem);
+	p->pages[page_idx].order = -1;
+}
+
+/* Takes PAGE_CNT contiguous free pages out of P's free lists and
+   returns the index of the first, or BITMAP_ERROR if there is no
+   large enough free block.  P must be locked. */
+static size_t
+buddy_alloc (struct pool *p, size_t page_cnt) {
+	int want = order_for (page_cnt);
+	size_t block_cnt = (size_t) 1 << want;
+	size_t page_idx;
+	int order;
+
+	for (order = want; order < PALLOC_ORDERS; order++)
+		if (!list_empty (&p->free_lists[order]))
+			break;
+	if (order >= PALLOC_ORDERS)
+		return BITMAP_ERROR;
+
+	page_idx = list_entry (list_front (&p->free_lists[order]),
+			struct page_info, elem) - p->pages;
+	block_remove (p, page_idx);
+
+	/* Split off upper halves until the block is as small as it
+	   can be. */
+	while (order > want) {
+		order--;
+		block_push (p, page_idx + ((size_t) 1 << order), order);
+	}
+	p->free_cnt -= block_cnt;
+
+	/* Give back what the request does not use. */
+	if (page_cnt < block_cnt)
+		buddy_free_range (p, page_idx + page_cnt, block_cnt - page_cnt);
+	return page_idx;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in P, merging it
+   with its buddy as long as the buddy is a free block of the same
+   order. */
+static void
+buddy_free (struct pool *p, size_t page_idx, int order) {
+	size_t pool_cnt = bitmap_size (p->used_map);
+
+	while (order < PALLOC_ORDERS - 1) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy >= pool_cnt || p->pages[buddy].order != order)
+			break;
+		block_remove (p, buddy);
+		page_idx &= ~((size_t) 1 << order);
+		order++;
+	}
+	block_push (p, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in P, as the
+   largest aligned blocks that tile the range.  P must be locked,
+   unless it is still being set up. */
+static void
+buddy_free_range (struct pool *p, size_t page_idx, size_t page_cnt) {
+	p->free_cnt += page_cnt;
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < PALLOC_ORDERS - 1
+				&& (page_idx & ((size_t) 1 << order)) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		buddy_free (p, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Takes the PAGE_CNT free pages starting at PAGE_IDX out of P's
+   free lists.  Each free block that overlaps the range is
+   removed, and its pages outside the range are freed again.  P
+   must be locked. */
+static void
+buddy_take_range (struct pool *p, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+
+	while (page_idx < end) {
+		size_t block, block_end;
+		int order;
+
+		/* Find the free block that contains PAGE_IDX. */
+		for (order = 0; order < PALLOC_ORDERS; order++) {
+			block = page_idx & ~(((size_t) 1 << order) - 1);
+			if (p->pages[block].order == order)
+				break;
+		}
+		ASSERT (order < PALLOC_ORDERS);
+		block_end = block + ((size_t) 1 << order);
+
+		block_remove (p, block);
+		p->free_cnt -= (size_t) 1 << order;
+		if (block < page_idx)
+			buddy_free_range (p, block, page_idx - block);
+		if (block_end > end)
+			buddy_free_range (p, end, block_end - end);
+		page_idx = block_end;
+	}
+}
@@ -0,0 +1,414 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator" (USENIX 1994).
+
+   A cache hands out objects of one exact size.  It carves them
+   out of "slabs", single pages that each start with a struct
+   slab header followed by as many objects as fit.  Free objects
+   of a slab are tracked by index in the header, not by links
+   stored in the objects, so an object keeps whatever state its
+   constructor gave it while it is free: a constructor runs once
+   per object, when its slab is created, and users must free
+   objects in that same state.
+
+   The space left over in a slab is used to start the objects of
+   successive slabs at different cache-line offsets ("colors"),
+   so that the objects at the same index in different slabs do
+   not all compete for the same CPU cache sets.
+
+   In front of the slabs, each CPU keeps a small stack of free
+   objects, so most allocations and frees take only that stack's
+   spinlock.  Slabs that become entirely free are kept for reuse
+   until the page allocator runs short, when kmem_reclaim() gives
+   them back. */
+
+/* Bytes in a CPU cache line, the unit of slab coloring. */
+#define CACHE_LINE 64
+
+/* Maximum number of objects in a per-CPU stack, and number moved
+   between a stack and the slabs at once. */
+#define CPU_OBJS 16
+#define CPU_BATCH 8
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Per-CPU stack of free objects. */
+struct kmem_cpu {
+	struct spinlock lock;           /* Taken by other CPUs only to drain. */
+	size_t cnt;                     /* # of objects in OBJS. */
+	void *objs[CPU_OBJS];           /* Most recently freed last. */
+};
+
+/* Object cache. */
+struct kmem_cache {
+	char name[16];                  /* For statistics. */
+	size_t size;                    /* Object size, a multiple of ALIGN. */
+	size_t align;                   /* Object alignment. */
+	kmem_ctor_func *ctor;           /* Constructor, or null. */
+	size_t objs_per_slab;           /* # of objects in a slab. */
+	size_t obj_ofs;                 /* Offset of the first object, uncolored. */
+	size_t color_cnt;               /* # of distinct colors. */
+	size_t next_color;              /* Color of the next slab created. */
+	struct list_elem elem;          /* Element in cache_list. */
+
+	struct adaptive_lock lock;      /* Protects the members below. */
+	struct list partial;            /* Slabs with free and used objects. */
+	struct list full;               /* Slabs with no free objects. */
+	struct list empty;              /* Slabs with no used objects. */
+	size_t slab_cnt;                /* # of slabs. */
+	size_t out_cnt;                 /* # of objects taken from slabs. */
+	size_t max_out_cnt;             /* Highest OUT_CNT so far. */
+
+	struct kmem_cpu cpus[CPU_MAX];  /* Indexed by CPU id. */
+};
+
+/* Slab header, at the start of the slab's page. */
+struct slab {
+	unsigned magic;                 /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;       /* Owning cache. */
+	struct list_elem elem;          /* In one of CACHE's slab lists. */
+	uint8_t *objs;                  /* First object. */
+	size_t free_cnt;                /* # of free objects. */
+	uint16_t free[];                /* Indexes of free objects. */
+};
+
+/* All caches, for statistics and reclamation. */
+static struct list cache_list;
+static struct lock cache_list_lock;
+
+static struct slab *slab_create (struct kmem_cache *);
+static size_t cache_take (struct kmem_cache *, void **objs, size_t cnt);
+static void cache_give (struct kmem_cache *, void **objs, size_t cnt);
+static void cpu_drain (struct kmem_cache *);
+
+/* Initializes the slab allocator. */
+void
+kmem_init (void) {
+	list_init (&cache_list);
+	lock_init (&cache_list_lock);
+}
+
+/* Creates and returns a cache of objects of SIZE bytes aligned
+   on ALIGN bytes, a power of 2 no larger than a cache line, or 0
+   for pointer alignment.  If CTOR is nonnull, it is run on each
+   object before the object is first handed out.  NAME is used in
+   statistics.  Returns a null pointer if memory is not
+   available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+		kmem_ctor_func *ctor) {
+	struct kmem_cache *c;
+	size_t leftover;
+
+	if (align == 0)
+		align = sizeof (void *);
+	ASSERT ((align & (align - 1)) == 0 && align <= CACHE_LINE);
+	ASSERT (size > 0 && size <= KMEM_MAX_SIZE);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+
+	strlcpy (c->name, name, sizeof c->name);
+	c->size = ROUND_UP (size, align);
+	c->align = align;
+	c->ctor = ctor;
+
+	/* Fit as many objects as possible after the header and its
+	   free index array. */
+	c->objs_per_slab = (PGSIZE - sizeof (struct slab))
+		/ (c->size + sizeof (uint16_t));
+	for (;;) {
+		c->obj_ofs = ROUND_UP (sizeof (struct slab)
+				+ c->objs_per_slab * sizeof (uint16_t), align);
+		if (c->obj_ofs + c->objs_per_slab * c->size <= PGSIZE)
+			break;
+		c->objs_per_slab--;
+	}
+	ASSERT (c->objs_per_slab > 0);
+	leftover = PGSIZE - c->obj_ofs - c->objs_per_slab * c->size;
+	c->color_cnt = leftover / CACHE_LINE + 1;
+	c->next_color = 0;
+
+	adaptive_lock_init (&c->lock);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->slab_cnt = c->out_cnt = c->max_out_cnt = 0;
+	for (int i = 0; i < CPU_MAX; i++) {
+		spinlock_init (&c->cpus[i].lock);
+		c->cpus[i].cnt = 0;
+	}
+
+	lock_acquire (&cache_list_lock);
+	list_push_back (&cache_list, &c->elem);
+	lock_release (&cache_list_lock);
+	return c;
+}
+
+/* Returns this CPU's stack of C's free objects.  As with the page
+   allocator's per-CPU caches, the CPU may change right after, but
+   each stack has its own lock. */
+static struct kmem_cpu *
+cpu_of (struct kmem_cache *c) {
+	return &c->cpus[this_cpu ()->id];
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	void *batch[CPU_BATCH];
+	struct kmem_cpu *cpu = cpu_of (c);
+	void *obj = NULL;
+	size_t n;
+
+	spinlock_acquire (&cpu->lock);
+	if (cpu->cnt > 0)
+		obj = cpu->objs[--cpu->cnt];
+	spinlock_release (&cpu->lock);
+	if (obj != NULL)
+		return obj;
+
+	/* Refill from the slabs, without the spinlock held because
+	   the cache lock may block. */
+	n = cache_take (c, batch, CPU_BATCH);
+	if (n == 0)
+		return NULL;
+	obj = batch[--n];
+
+	cpu = cpu_of (c);
+	spinlock_acquire (&cpu->lock);
+	while (n > 0 && cpu->cnt < CPU_OBJS)
+		cpu->objs[cpu->cnt++] = batch[--n];
+	spinlock_release (&cpu->lock);
+	if (n > 0)
+		cache_give (c, batch, n);
+	return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C and be
+   in its constructed state, to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	void *batch[CPU_BATCH];
+	struct kmem_cpu *cpu;
+	size_t n = 0;
+
+	if (obj == NULL)
+		return;
+	ASSERT (((struct slab *) pg_round_down (obj))->magic == SLAB_MAGIC);
+	ASSERT (((struct slab *) pg_round_down (obj))->cache == c);
+
+	cpu = cpu_of (c);
+	spinlock_acquire (&cpu->lock);
+	if (cpu->cnt >= CPU_OBJS) {
+		n = CPU_BATCH;
+		memcpy (batch, cpu->objs, sizeof batch);
+		cpu->cnt -= n;
+		memmove (cpu->objs, cpu->objs + n, cpu->cnt * sizeof *cpu->objs);
+	}
+	cpu->objs[cpu->cnt++] = obj;
+	spinlock_release (&cpu->lock);
+	if (n > 0)
+		cache_give (c, batch, n);
+}
+
+/* Gives the pages of empty slabs in every cache back to the page
+   allocator, after flushing the per-CPU stacks into the slabs.
+   Called by the page allocator when it runs out of pages, so it
+   skips caches whose lock the running thread already holds, and
+   gives up if another thread is reclaiming.  Returns the number
+   of pages freed. */
+size_t
+kmem_reclaim (void) {
+	struct list_elem *e;
+	size_t freed = 0;
+
+	if (lock_held_by_current_thread (&cache_list_lock)
+			|| !lock_try_acquire (&cache_list_lock))
+		return 0;
+
+	for (e = list_begin (&cache_list); e != list_end (&cache_list);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		struct list empty;
+
+		if (adaptive_lock_held_by_current_thread (&c->lock))
+			continue;
+		cpu_drain (c);
+		adaptive_lock_acquire (&c->lock);
+		list_init (&empty);
+		while (!list_empty (&c->empty)) {
+			list_push_back (&empty, list_pop_front (&c->empty));
+			c->slab_cnt--;
+		}
+		adaptive_lock_release (&c->lock);
+
+		while (!list_empty (&empty)) {
+			struct slab *s = list_entry (list_pop_front (&empty),
+					struct slab, elem);
+
+			s->magic = 0;
+			palloc_free_page (s);
+			freed++;
+		}
+	}
+	lock_release (&cache_list_lock);
+	return freed;
+}
+
+/* Prints the memory used by each cache, and what the same objects
+   would cost if they came from malloc() instead. */
+void
+kmem_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&cache_list_lock);
+	for (e = list_begin (&cache_list); e != list_end (&cache_list);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+		printf ("Slab: %s: %zu-byte objects, %zu per slab, %zu slabs; "
+				"peak %zu objects in %zu bytes, %zu bytes with malloc\n",
+				c->name, c->size, c->objs_per_slab, c->slab_cnt,
+				c->max_out_cnt,
+				DIV_ROUND_UP (c->max_out_cnt, c->objs_per_slab) * PGSIZE,
+				c->max_out_cnt * malloc_block_size (c->size));
+	}
+	lock_release (&cache_list_lock);
+}
+
+/* Returns the I'th object of slab S. */
+static void *
+slab_obj (struct slab *s, size_t i) {
+	return s->objs + i * s->cache->size;
+}
+
+/* Allocates a new slab for cache C and constructs its objects.
+   Returns a null pointer if memory is not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	size_t color;
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+
+	adaptive_lock_acquire (&c->lock);
+	color = c->next_color;
+	c->next_color = (c->next_color + 1) % c->color_cnt;
+	adaptive_lock_release (&c->lock);
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->objs = (uint8_t *) s + c->obj_ofs + color * CACHE_LINE;
+	s->free_cnt = c->objs_per_slab;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->free[i] = c->objs_per_slab - 1 - i;
+		if (c->ctor != NULL)
+			c->ctor (slab_obj (s, i));
+	}
+	return s;
+}
+
+/* Takes up to CNT free objects out of C's slabs into OBJS[],
+   creating slabs as needed.  Returns the number taken. */
+static size_t
+cache_take (struct kmem_cache *c, void **objs, size_t cnt) {
+	size_t n = 0;
+
+	adaptive_lock_acquire (&c->lock);
+	while (n < cnt) {
+		struct slab *s;
+
+		if (!list_empty (&c->partial))
+			s = list_entry (list_front (&c->partial), struct slab, elem);
+		else if (!list_empty (&c->empty)) {
+			s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+			list_push_front (&c->partial, &s->elem);
+		} else {
+			/* Grow without the lock held, so that the page
+			   allocator may reclaim from this cache. */
+			adaptive_lock_release (&c->lock);
+			s = slab_create (c);
+			adaptive_lock_acquire (&c->lock);
+			if (s == NULL)
+				break;
+			c->slab_cnt++;
+			list_push_front (&c->partial, &s->elem);
+		}
+
+		while (n < cnt && s->free_cnt > 0)
+			objs[n++] = slab_obj (s, s->free[--s->free_cnt]);
+		if (s->free_cnt == 0) {
+			list_remove (&s->elem);
+			list_push_front (&c->full, &s->elem);
+		}
+	}
+	c->out_cnt += n;
+	if (c->out_cnt > c->max_out_cnt)
+		c->max_out_cnt = c->out_cnt;
+	adaptive_lock_release (&c->lock);
+	return n;
+}
+
+/* Returns the CNT objects in OBJS[] to their slabs in C. */
+static void
+cache_give (struct kmem_cache *c, void **objs, size_t cnt) {
+	adaptive_lock_acquire (&c->lock);
+	for (size_t i = 0; i < cnt; i++) {
+		struct slab *s = pg_round_down (objs[i]);
+		size_t idx = ((uint8_t *) objs[i] - s->objs) / c->size;
+
+		ASSERT (s->magic == SLAB_MAGIC && s->cache == c);
+		ASSERT (slab_obj (s, idx) == objs[i]);
+		ASSERT (s->free_cnt < c->objs_per_slab);
+
+		if (s->free_cnt == 0) {
+			list_remove (&s->elem);
+			list_push_front (&c->partial, &s->elem);
+		}
+		s->free[s->free_cnt++] = idx;
+		if (s->free_cnt == c->objs_per_slab) {
+			list_remove (&s->elem);
+			list_push_front (&c->empty, &s->elem);
+		}
+	}
+	c->out_cnt -= cnt;
+	adaptive_lock_release (&c->lock);
+}
+
+/* Moves the objects in every CPU's stack of C back to the
+   slabs. */
+static void
+cpu_drain (struct kmem_cache *c) {
+	void *batch[CPU_OBJS];
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		struct kmem_cpu *cpu = &c->cpus[i];
+		size_t n;
+
+		spinlock_acquire (&cpu->lock);
+		n = cpu->cnt;
+		memcpy (batch, cpu->objs, n * sizeof *cpu->objs);
+		cpu->cnt = 0;
+		spinlock_release (&cpu->lock);
+		if (n > 0)
+			cache_give (c, batch, n);
+	}
+}
@@ -29,6 +29,7 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
@@ -116,15 +117,16 @@ sema_up (struct semaphore *sema) {
                struct thread, elem));
    }
    sema->value++;
-   // thread_yield();
-   thread_set_priority(thread_current()->priority_origin);
-   //#diff
-
-   // thread_set_priority(thread_get_priority());
    intr_set_level (old_level);
+   thread_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
+static bool donor_less (const struct heap_elem *, const struct heap_elem *,
+		void *aux);
+static void donation_update (struct thread *);
+static struct thread *lock_update_priority (struct lock *);
+static void rwlock_update_priority (struct rwlock *);
 
 /* Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
@@ -180,6 +182,8 @@ lock_init (struct lock *lock) {
 
 	lock->holder = NULL;
 	sema_init (&lock->semaphore, 1);
+	heap_init (&lock->donors, donor_less, NULL);
+	lock->priority = PRI_MIN;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -192,19 +196,38 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-   if (lock->holder != NULL){
-      thread_current()->wait_on_lock = lock;
-      //#diff
-      list_push_back(&lock->holder->donation,&thread_current()->d_elem);
-      donate_priority();
-   }
-   sema_down (&lock->semaphore);
-   thread_current()->wait_on_lock = NULL;
-   lock->holder = thread_current();
+	old_level = intr_disable ();
+	if (!thread_mlfqs && lock->semaphore.value == 0) {
+		struct thread *t;
+
+		/* Donate our priority to the holder, and on down the
+		   chain of locks it waits for. */
+		curr->wait_on_lock = lock;
+		heap_push (&lock->donors, &curr->donor_elem);
+		t = lock_update_priority (lock);
+		if (t != NULL)
+			donation_update (t);
+	}
+	sema_down (&lock->semaphore);
+	if (curr->wait_on_lock != NULL) {
+		heap_remove (&lock->donors, &curr->donor_elem);
+		curr->wait_on_lock = NULL;
+		lock_update_priority (lock);
+	}
+	lock->holder = curr;
+	heap_push (&curr->held_locks, &lock->elem);
+
+	/* Inherit the priority of any threads still waiting. */
+	if (!thread_mlfqs)
+		thread_refresh_priority (curr);
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -215,46 +238,113 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
-	if (success)
-		lock->holder = thread_current ();
+	if (success) {
+		lock->holder = curr;
+		heap_push (&curr->held_locks, &lock->elem);
+		if (!thread_mlfqs)
+			thread_refresh_priority (curr);
+	}
+	intr_set_level (old_level);
 	return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
-   This is lock_release function.
+   Gives up whatever priority LOCK's waiters donated to us, which
+   takes O(log n) time in the number of locks we hold.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
    handler. */
 void
 lock_release (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-   int max_priority = lock->holder->priority_origin;
-   struct list_elem* tmp_delem;
-   //#diff
-   for (tmp_delem = lock->holder->donation.head.next; tmp_delem!=&(lock->holder->donation).tail;){
-      struct thread *thread_ptr = list_entry(tmp_delem, struct thread , d_elem);
-      if(thread_ptr->wait_on_lock ==lock){
-            tmp_delem = list_remove(tmp_delem);
-      }
-      else{
-        if(max_priority < thread_ptr->priority){
-            max_priority = thread_ptr->priority;
-            tmp_delem=list_next(tmp_delem);
-        }
-      }
-      lock->holder->priority =max_priority;
-   } 
-	sema_up (&lock->semaphore);
+	old_level = intr_disable ();
+	heap_remove (&curr->held_locks, &lock->elem);
 	lock->holder = NULL;
+	sema_up (&lock->semaphore);
+	if (!thread_mlfqs)
+		thread_refresh_priority (curr);
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Returns true if LOCK's highest waiter priority is less than
+   B's.  Orders a thread's held_locks heap. */
+bool
+lock_priority_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct lock, elem)->priority
+		< heap_entry (b, struct lock, elem)->priority;
+}
+
+/* Returns true if waiting thread A has lower priority than
+   waiting thread B.  Orders the donors heap of a lock or
+   reader-writer lock. */
+static bool
+donor_less (const struct heap_elem *a, const struct heap_elem *b,
+		void *aux UNUSED) {
+	return heap_entry (a, struct thread, donor_elem)->priority
+		< heap_entry (b, struct thread, donor_elem)->priority;
+}
+
+/* Called when the priority of T, a thread that may be waiting
+   for a lock or reader-writer lock, has changed.  Restores the
+   heap order of the lock's donors and passes any change in the
+   lock's highest waiter priority on to its holder, then to what
+   that holder waits for, and so on.  Each step takes O(log n)
+   time, so a chain of D locks costs O(D log n).
+
+   Lock chains are followed iteratively, because they can be
+   far deeper than a thread's stack allows recursion.  Interrupts
+   must be off. */
+static void
+donation_update (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	while (t != NULL && t->wait_on_lock != NULL) {
+		heap_update (&t->wait_on_lock->donors, &t->donor_elem);
+		t = lock_update_priority (t->wait_on_lock);
+	}
+	if (t != NULL && t->wait_on_rwlock != NULL) {
+		heap_update (&t->wait_on_rwlock->donors, &t->donor_elem);
+		rwlock_update_priority (t->wait_on_rwlock);
+	}
+}
+
+/* Recomputes LOCK's highest waiter priority after a change to
+   its donors.  If that changes the priority of LOCK's holder,
+   returns the holder, so the caller can pass the change on;
+   otherwise returns a null pointer. */
+static struct thread *
+lock_update_priority (struct lock *lock) {
+	struct thread *holder = lock->holder;
+	int priority = PRI_MIN;
+
+	if (!heap_empty (&lock->donors))
+		priority = heap_entry (heap_top (&lock->donors),
+				struct thread, donor_elem)->priority;
+	if (priority == lock->priority)
+		return NULL;
+
+	lock->priority = priority;
+	if (holder == NULL)
+		return NULL;
+	heap_update (&holder->held_locks, &lock->elem);
+	return thread_refresh_priority (holder) ? holder : NULL;
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -267,6 +357,421 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
+/* Maximum number of times adaptive_lock_acquire() polls a lock
+   whose holder is running on another CPU before blocking. */
+#define ADAPTIVE_SPIN_LIMIT 1000
+
+/* Initializes adaptive lock LOCK, which is initially free. */
+void
+adaptive_lock_init (struct adaptive_lock *lock) {
+	ASSERT (lock != NULL);
+
+	lock_init (&lock->lock);
+	lock->spin_cnt = lock->yield_cnt = lock->block_cnt = 0;
+}
+
+/* Acquires LOCK, which must not already be held by the current
+   thread.
+
+   If LOCK is busy and its holder is running on another CPU, it
+   will likely release LOCK soon, so we poll instead of paying
+   for two context switches.  On a uniprocessor the holder
+   cannot be running, but if it was preempted inside the short
+   critical section and can run before us, we yield once to let
+   it finish.  If neither works, we block in lock_acquire(),
+   donating our priority to the holder.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+adaptive_lock_acquire (struct adaptive_lock *lock) {
+	struct thread *holder;
+
+	ASSERT (lock != NULL);
+	ASSERT (!intr_context ());
+
+	if (lock_try_acquire (&lock->lock))
+		return;
+
+	for (int i = 0; i < ADAPTIVE_SPIN_LIMIT; i++) {
+		holder = lock->lock.holder;
+		if (holder != NULL
+				&& (holder->status != THREAD_RUNNING || holder->cpu == this_cpu ()))
+			break;
+		if (lock_try_acquire (&lock->lock)) {
+			lock->spin_cnt++;
+			return;
+		}
+		asm volatile ("pause");
+	}
+
+	holder = lock->lock.holder;
+	if (cpu_online_cnt == 1 && holder != NULL
+			&& holder->status == THREAD_READY
+			&& holder->priority >= thread_get_priority ()) {
+		thread_yield ();
+		if (lock_try_acquire (&lock->lock)) {
+			lock->yield_cnt++;
+			return;
+		}
+	}
+
+	lock_acquire (&lock->lock);
+	lock->block_cnt++;
+}
+
+/* Tries to acquire LOCK without spinning or sleeping, and
+   returns true if successful or false on failure. */
+bool
+adaptive_lock_try_acquire (struct adaptive_lock *lock) {
+	ASSERT (lock != NULL);
+
+	return lock_try_acquire (&lock->lock);
+}
+
+/* Releases LOCK, which must be owned by the current thread. */
+void
+adaptive_lock_release (struct adaptive_lock *lock) {
+	ASSERT (lock != NULL);
+
+	lock_release (&lock->lock);
+}
+
+/* Returns true if the current thread holds LOCK, false
+   otherwise. */
+bool
+adaptive_lock_held_by_current_thread (const struct adaptive_lock *lock) {
+	ASSERT (lock != NULL);
+
+	return lock_held_by_current_thread (&lock->lock);
+}
+
+static void rwlock_wait (struct rwlock *, struct list *waiters);
+static struct rwlock_hold *rwlock_free_hold (struct thread *);
+static void rwlock_grant (struct rwlock *, struct thread *, bool exclusive);
+static void rwlock_drop (struct rwlock *);
+static void rwlock_wake (struct rwlock *);
+
+/* Initializes reader-writer lock RW, which is initially free. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	rw->readers = 0;
+	rw->writer = NULL;
+	list_init (&rw->holders);
+	list_init (&rw->read_waiters);
+	list_init (&rw->write_waiters);
+	heap_init (&rw->donors, donor_less, NULL);
+	rw->priority = PRI_MIN;
+}
+
+/* Acquires RW shared, sleeping while a thread holds it exclusive
+   or waits to.  RW must not already be held by the current
+   thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_shared (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+	ASSERT (rwlock_free_hold (thread_current ()) != NULL);
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && list_empty (&rw->write_waiters))
+		rwlock_grant (rw, thread_current (), false);
+	else
+		rwlock_wait (rw, &rw->read_waiters);
+	intr_set_level (old_level);
+}
+
+/* Acquires RW exclusive, sleeping until no other thread holds
+   it.  RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_exclusive (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_by_current_thread (rw));
+	ASSERT (rwlock_free_hold (thread_current ()) != NULL);
+
+	old_level = intr_disable ();
+	if (rw->writer == NULL && rw->readers == 0)
+		rwlock_grant (rw, thread_current (), true);
+	else
+		rwlock_wait (rw, &rw->write_waiters);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold shared. */
+void
+rwlock_release_shared (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_held_by_current_thread (rw));
+	ASSERT (rw->writer == NULL && rw->readers > 0);
+
+	old_level = intr_disable ();
+	rwlock_drop (rw);
+	if (--rw->readers == 0)
+		rwlock_wake (rw);
+	if (!thread_mlfqs)
+		thread_refresh_priority (thread_current ());
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Releases RW, which the current thread must hold exclusive. */
+void
+rwlock_release_exclusive (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rw->writer == thread_current ());
+
+	old_level = intr_disable ();
+	rwlock_drop (rw);
+	rw->writer = NULL;
+	rwlock_wake (rw);
+	if (!thread_mlfqs)
+		thread_refresh_priority (thread_current ());
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Returns true if the current thread holds RW, shared or
+   exclusive, false otherwise. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (rw != NULL);
+
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (curr->rw_holds[i].lock == rw)
+			return true;
+	return false;
+}
+
+/* Returns the highest priority among threads waiting for a
+   reader-writer lock that T holds, or PRI_MIN if there are
+   none. */
+int
+rwlock_donated_priority (const struct thread *t) {
+	int priority = PRI_MIN;
+
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++) {
+		struct rwlock *rw = t->rw_holds[i].lock;
+		if (rw != NULL && rw->priority > priority)
+			priority = rw->priority;
+	}
+	return priority;
+}
+
+/* Puts the current thread on WAITERS, one of RW's wait lists,
+   and sleeps until a releasing thread hands RW over to it.
+   Interrupts must be off. */
+static void
+rwlock_wait (struct rwlock *rw, struct list *waiters) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	curr->wait_on_rwlock = rw;
+	list_push_back (waiters, &curr->elem);
+	if (!thread_mlfqs) {
+		heap_push (&rw->donors, &curr->donor_elem);
+		rwlock_update_priority (rw);
+	}
+	thread_block ();
+}
+
+/* Returns one of T's unused hold slots, or a null pointer if T
+   already holds RWLOCK_HOLD_MAX reader-writer locks. */
+static struct rwlock_hold *
+rwlock_free_hold (struct thread *t) {
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (t->rw_holds[i].lock == NULL)
+			return &t->rw_holds[i];
+	return NULL;
+}
+
+/* Makes T a holder of RW, shared or EXCLUSIVE, taking one of T's
+   hold slots. */
+static void
+rwlock_grant (struct rwlock *rw, struct thread *t, bool exclusive) {
+	struct rwlock_hold *hold = rwlock_free_hold (t);
+
+	ASSERT (hold != NULL);
+
+	hold->lock = rw;
+	hold->thread = t;
+	list_push_back (&rw->holders, &hold->elem);
+	if (t->wait_on_rwlock != NULL) {
+		if (!thread_mlfqs)
+			heap_remove (&rw->donors, &t->donor_elem);
+		t->wait_on_rwlock = NULL;
+	}
+	if (exclusive)
+		rw->writer = t;
+	else
+		rw->readers++;
+}
+
+/* Frees the current thread's hold slot for RW. */
+static void
+rwlock_drop (struct rwlock *rw) {
+	struct thread *curr = thread_current ();
+
+	for (int i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (curr->rw_holds[i].lock == rw) {
+			list_remove (&curr->rw_holds[i].elem);
+			curr->rw_holds[i].lock = NULL;
+			return;
+		}
+	NOT_REACHED ();
+}
+
+/* Hands RW, which has just become free, to its waiters: the
+   highest-priority waiting writer if there is one, otherwise all
+   waiting readers at once.  Threads left waiting then donate to
+   the new holders. */
+static void
+rwlock_wake (struct rwlock *rw) {
+	struct list_elem *e;
+	struct thread *t;
+
+	ASSERT (rw->writer == NULL && rw->readers == 0);
+
+	if (!list_empty (&rw->write_waiters)) {
+		list_sort (&rw->write_waiters, less_priority, NULL);
+		t = list_entry (list_pop_front (&rw->write_waiters), struct thread, elem);
+		rwlock_grant (rw, t, true);
+		thread_unblock (t);
+	} else
+		while (!list_empty (&rw->read_waiters)) {
+			t = list_entry (list_pop_front (&rw->read_waiters), struct thread, elem);
+			rwlock_grant (rw, t, false);
+			thread_unblock (t);
+		}
+
+	if (thread_mlfqs)
+		return;
+	rwlock_update_priority (rw);
+	for (e = list_begin (&rw->holders); e != list_end (&rw->holders);
+			e = list_next (e))
+		thread_refresh_priority (list_entry (e, struct rwlock_hold, elem)->thread);
+}
+
+/* Recomputes RW's highest waiter priority after a change to its
+   donors, and passes any change on to each holder of RW and what
+   it waits for. */
+static void
+rwlock_update_priority (struct rwlock *rw) {
+	struct list_elem *e;
+	int priority = PRI_MIN;
+
+	if (!heap_empty (&rw->donors))
+		priority = heap_entry (heap_top (&rw->donors),
+				struct thread, donor_elem)->priority;
+	if (priority == rw->priority)
+		return;
+
+	rw->priority = priority;
+	for (e = list_begin (&rw->holders); e != list_end (&rw->holders);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct rwlock_hold, elem)->thread;
+		if (thread_refresh_priority (t))
+			donation_update (t);
+	}
+}
+
+/* Initializes spinlock LOCK, which is initially free. */
+void
+spinlock_init (struct spinlock *lock) {
+	ASSERT (lock != NULL);
+
+	lock->locked = 0;
+	lock->cpu = NULL;
+	lock->old_level = INTR_OFF;
+}
+
+/* Disables interrupts on the local CPU and busy-waits until LOCK
+   is free, then takes it.  The previous interrupt level is
+   restored by spinlock_release().
+
+   Spinning with interrupts off is only reasonable because the
+   other CPU holding LOCK does so for a handful of instructions.
+   Acquiring a spinlock this CPU already holds deadlocks, which
+   is caught by the assertion below. */
+void
+spinlock_acquire (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (lock != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (!spinlock_held (lock));
+	while (__atomic_exchange_n (&lock->locked, 1, __ATOMIC_ACQUIRE))
+		/* Wait on a plain load so the cache line stays shared
+		   until the holder releases it. */
+		while (lock->locked)
+			asm volatile ("pause");
+	lock->cpu = this_cpu ();
+	lock->old_level = old_level;
+}
+
+/* Tries to take LOCK without spinning.  Returns true, with
+   interrupts disabled, if successful; otherwise returns false
+   and leaves the interrupt level unchanged. */
+bool
+spinlock_try_acquire (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (lock != NULL);
+
+	old_level = intr_disable ();
+	if (__atomic_exchange_n (&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+		intr_set_level (old_level);
+		return false;
+	}
+	lock->cpu = this_cpu ();
+	lock->old_level = old_level;
+	return true;
+}
+
+/* Releases LOCK, which must be held by this CPU, and restores
+   the interrupt level from before it was acquired. */
+void
+spinlock_release (struct spinlock *lock) {
+	enum intr_level old_level;
+
+	ASSERT (spinlock_held (lock));
+
+	old_level = lock->old_level;
+	lock->cpu = NULL;
+	__atomic_store_n (&lock->locked, 0, __ATOMIC_RELEASE);
+	intr_set_level (old_level);
+}
+
+/* Returns true if this CPU holds LOCK. */
+bool
+spinlock_held (const struct spinlock *lock) {
+	ASSERT (lock != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	return lock->locked && lock->cpu == this_cpu ();
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem {
 	struct list_elem elem;              /* List element. */
@@ -355,25 +860,6 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 		cond_signal (cond, lock);
 }
 
-void donate_priority(void){
-   struct thread *tmp;
-   for(tmp = thread_current();(tmp->wait_on_lock !=NULL) &&
-                           (tmp->wait_on_lock->holder->priority < tmp->priority); tmp = tmp->wait_on_lock->holder)
-   {
-      struct list_elem* tmp_delem;
-      int max_priority = tmp->wait_on_lock->holder->priority_origin;
-      for (tmp_delem = tmp->wait_on_lock->holder->donation.head.next; 
-                           tmp_delem!=&(tmp->wait_on_lock->holder->donation).tail; tmp_delem=list_next(tmp_delem)){
-         struct thread *thread_ptr = list_entry(tmp_delem, struct thread, d_elem);
-         if(max_priority < thread_ptr->priority)
-         {
-            max_priority = thread_ptr->priority;
-         }
-      }
-      tmp->wait_on_lock->holder->priority = max_priority;
-   }
-}
-
 bool cmp_cond_waiters(const struct list_elem *a, const struct list_elem *b, void *aux){
 	// struct thread* thread_a = list_entry(a,struct thread, elem);
 	// struct thread* thread_b = list_entry(b,struct thread, elem);
@@ -4,12 +4,15 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -24,14 +27,30 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;
-static int64_t min_wakeup_tick;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, wait in the run queue
+   of the CPU in their `cpu' member.  See struct runqueue in
+   threads/cpu.h. */
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
+
+/* Processes sleeping in timer_sleep(), kept in a two-level timing
+   wheel.  Level 0 has one slot per tick for the next WHEEL_SIZE
+   ticks, level 1 has one slot per WHEEL_SIZE ticks for the next
+   WHEEL_SIZE * WHEEL_SIZE ticks, and anything further away waits
+   on sleep_overflow.  Outer slots are cascaded inward as the wheel
+   turns, so putting a thread to sleep is constant time and each
+   tick only has to look at a single level-0 slot. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+static struct list sleep_wheel0[WHEEL_SIZE];
+static struct list sleep_wheel1[WHEEL_SIZE];
+static struct list sleep_overflow;
+static int64_t wheel_next_tick;  /* First tick not yet processed. */
+static size_t sleeper_cnt;       /* # of threads in the wheel. */
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -49,22 +68,38 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* 4.4BSD scheduler state, used only if thread_mlfqs is true. */
+#define NICE_MIN -20                    /* Lowest nice value. */
+#define NICE_MAX 20                     /* Highest nice value. */
+#define MLFQS_PRI_INTERVAL 4            /* Ticks between priority updates. */
+static fixed_t load_avg;                /* System load average. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
 static tid_t allocate_tid (void);
-bool less_wakeuptick(const struct list_elem *a, const struct list_elem *b, void *aux);
+static void ready_queue_push (struct thread *);
+static void ready_queue_remove (struct thread *);
+static struct thread *ready_queue_pop (struct cpu *);
+static int ready_queue_max_priority (struct cpu *);
+static void reap_dying_threads (void);
+static void sleep_wheel_insert (struct thread *, int64_t next_tick);
+static void mlfqs_tick (struct thread *);
+static int mlfqs_priority (const struct thread *);
+static bool sleep_wheel_expire (int64_t tick);
+static void sched_ready (struct thread *, bool wakeup);
+static void sched_account (struct cpu *, struct thread *curr,
+		struct thread *next);
 bool less_priority(const struct list_elem *a, const struct list_elem *b, void *aux);
 
 /* Returns true if T appears to point to a valid thread. */
@@ -77,6 +112,11 @@ bool less_priority(const struct list_elem *a, const struct list_elem *b, void *a
  * somewhere in the middle, this locates the curent thread. */
 #define running_thread() ((struct thread *) (pg_round_down (rrsp ())))
 
+/* Returns true if T is the idle thread of its CPU.  Idle threads
+   never move to another CPU. */
+#define is_idle(t) ((t) == (t)->cpu->idle)
+
+
 
 // Global descriptor table for the thread_start.
 // Because the gdt will be setup after the thread_init, we should
@@ -111,15 +151,28 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);
+	for (int i = 0; i < CPU_MAX; i++) {
+		struct cpu *cpu = &cpus[i];
+
+		cpu->id = i;
+		spinlock_init (&cpu->rq.lock);
+		for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+			list_init (&cpu->rq.queues[pri]);
+	}
+	cpus[0].online = true;
+	list_init (&all_list);
+	for (int i = 0; i < WHEEL_SIZE; i++) {
+		list_init (&sleep_wheel0[i]);
+		list_init (&sleep_wheel1[i]);
+	}
+	list_init (&sleep_overflow);
 	list_init (&destruction_req);
-	min_wakeup_tick = INT64_MAX;
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread ();
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
+	cpus[0].curr = initial_thread;
 	initial_thread->tid = allocate_tid ();
 }
 
@@ -135,7 +188,7 @@ thread_start (void) {
 	/* Start preemptive thread scheduling. */
 	intr_enable ();
 
-	/* Wait for the idle thread to initialize idle_thread. */
+	/* Wait for the idle thread to initialize this CPU's `idle'. */
 	sema_down (&idle_started);
 }
 
@@ -144,9 +197,10 @@ thread_start (void) {
 void
 thread_tick (void) {
 	struct thread *t = thread_current ();
+	struct cpu *cpu = this_cpu ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
+	if (t == cpu->idle)
 		idle_ticks++;
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
@@ -155,8 +209,11 @@ thread_tick (void) {
 	else
 		kernel_ticks++;
 
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	if (++cpu->slice_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
 }
 
@@ -167,6 +224,85 @@ thread_print_stats (void) {
 			idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Adds the counters in B to those in A. */
+static void
+sched_counts_add (struct sched_counts *a, const struct sched_counts *b) {
+	a->wait += b->wait;
+	a->voluntary += b->voluntary;
+	a->involuntary += b->involuntary;
+	a->wakeups += b->wakeups;
+	for (int i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+		a->latency[i] += b->latency[i];
+}
+
+/* Fills STATS, an array of CNT records, with scheduling
+   statistics.  The first record sums the statistics of every
+   thread that ever ran, including those that have exited, and
+   has tid 0; the rest describe the live threads, one each, until
+   STATS is full.  Returns the number of records filled in. */
+int
+thread_sched_stats (struct sched_stats *stats, int cnt) {
+	enum intr_level old_level;
+	struct list_elem *e;
+	int n = 0;
+
+	if (cnt <= 0)
+		return 0;
+
+	old_level = intr_disable ();
+	memset (&stats[0], 0, sizeof stats[0]);
+	strlcpy (stats[0].name, "total", sizeof stats[0].name);
+	for (int i = 0; i < cpu_cnt; i++)
+		sched_counts_add (&stats[0].counts, &cpus[i].sched);
+	n++;
+
+	for (e = list_begin (&all_list); e != list_end (&all_list) && n < cnt;
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, all_elem);
+		struct sched_stats *s = &stats[n++];
+
+		s->tid = t->tid;
+		strlcpy (s->name, t->name, sizeof s->name);
+		s->priority = t->priority;
+		s->counts = t->sched;
+	}
+	intr_set_level (old_level);
+	return n;
+}
+
+/* Prints scheduling statistics: the wakeup latency histogram of
+   the whole system, then one line per live thread. */
+void
+thread_print_sched_stats (void) {
+	struct sched_counts total;
+	struct list_elem *e;
+
+	memset (&total, 0, sizeof total);
+	for (int i = 0; i < cpu_cnt; i++)
+		sched_counts_add (&total, &cpus[i].sched);
+
+	printf ("Scheduler: %llu voluntary, %llu involuntary switches, "
+			"%llu wakeups\n", (unsigned long long) total.voluntary,
+			(unsigned long long) total.involuntary,
+			(unsigned long long) total.wakeups);
+	for (int i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+		if (total.latency[i] != 0)
+			printf ("Wakeup latency >= 2^%d cycles: %u\n", i, total.latency[i]);
+
+	printf ("  TID NAME             PRI    WAIT CYCLES   VOL INVOL  WAKE\n");
+	for (e = list_begin (&all_list); e != list_end (&all_list);
+			e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, all_elem);
+
+		printf ("%5d %-16s %3d %14llu %5llu %5llu %5llu\n",
+				t->tid, t->name, t->priority,
+				(unsigned long long) t->sched.wait,
+				(unsigned long long) t->sched.voluntary,
+				(unsigned long long) t->sched.involuntary,
+				(unsigned long long) t->sched.wakeups);
+	}
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -190,6 +326,8 @@ thread_create (const char *name, int priority,
  
 	ASSERT (function != NULL);
 
+	reap_dying_threads ();
+
 	/* Allocate thread. */
 	t = palloc_get_page (PAL_ZERO);			/* 페이지 할당 */
 	if (t == NULL)
@@ -199,6 +337,11 @@ thread_create (const char *name, int priority,
 	/* Initialize thread. */
 	init_thread (t, name, priority);		/* 쓰레드 스트럭처 초기화*/
 	tid = t->tid = allocate_tid ();			/* tid 할당 */
+	if (thread_mlfqs) {
+		t->nice = thread_current ()->nice;
+		t->recent_cpu = thread_current ()->recent_cpu;
+		t->priority = t->priority_origin = mlfqs_priority (t);
+	}
 
 	// struct file **new_fdt = (struct file **)palloc_get_page(PAL_ZERO); //deleted 23:12
 	// t->fdt = new_fdt; //deleted 23:12
@@ -228,9 +371,7 @@ thread_create (const char *name, int priority,
 
 	/* Compare the priorities of the currently running thread and the newly
 	inserted one. Yield the CPU if the newly arriving thread has higer priority*/
-	if (thread_current()->priority < t->priority){
-		thread_yield();
-	}
+	thread_preempt ();
 	return tid;
 }
 
@@ -263,11 +404,31 @@ thread_unblock (struct thread *t) {
 	old_level = intr_disable ();
 
 	ASSERT (t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem,less_priority, NULL);
 	t->status = THREAD_READY;
+	sched_ready (t, true);
+	ready_queue_push (t);
 	intr_set_level (old_level);
 }
 
+/* Returns the CPU we are running on.
+
+   The running thread is found from the stack pointer, and the
+   scheduler records in each thread the CPU it is dispatched on,
+   so this needs no per-CPU segment register.  Until thread_init()
+   has set up the initial thread, only the bootstrap processor is
+   running.
+
+   The result is only stable while interrupts are disabled;
+   otherwise the thread may move to another CPU right after. */
+struct cpu *
+this_cpu (void) {
+	struct thread *t = running_thread ();
+
+	if (!is_thread (t) || t->cpu == NULL)
+		return &cpus[0];
+	return t->cpu;
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) {
@@ -307,10 +468,13 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	fpu_release (thread_current ());
+	reap_dying_threads ();
 
 	/* Just set our status to dying and schedule another process.
-	   We will be destroyed during the call to schedule_tail(). */
+	   We will be destroyed during the call to reap_dying_threads(). */
 	intr_disable ();
+	list_remove (&thread_current ()->all_elem);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -325,8 +489,10 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable ();
-	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem,less_priority,NULL);
+	if (!is_idle (curr)) {
+		sched_ready (curr, false);
+		ready_queue_push (curr);
+	}
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
@@ -334,25 +500,88 @@ thread_yield (void) {
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) {
+	/* The 4.4BSD scheduler computes priorities by itself. */
+	if (thread_mlfqs) {
+		thread_preempt ();
+		return;
+	}
+
+	enum intr_level old_level = intr_disable ();
 	thread_current ()->priority_origin = new_priority;
-	thread_current ()->priority = new_priority;
-
-	//#diff, #check
-	int max_priority = new_priority;
-	struct list_elem* tmp_delem;
-	for (tmp_delem = thread_current()->donation.head.next; 
-                           tmp_delem!=&(thread_current()->donation).tail; tmp_delem=list_next(tmp_delem)){
-			struct thread *thread_ptr = list_entry(tmp_delem, struct thread, d_elem);
-			if(max_priority < thread_ptr->priority)
-			{
-				max_priority = thread_ptr->priority;
-			}
+	thread_refresh_priority (thread_current ());
+	intr_set_level (old_level);
+	thread_preempt ();
+}
+
+/* Yields the CPU if a ready thread has higher priority than the
+   running thread.  In an interrupt handler, arranges to yield on
+   return from the interrupt instead. */
+void
+thread_preempt (void) {
+	enum intr_level old_level = intr_disable ();
+	struct thread *curr = thread_current ();
+	bool yield = !is_idle (curr)
+		&& curr->priority < ready_queue_max_priority (curr->cpu);
+
+	intr_set_level (old_level);
+	if (!yield)
+		return;
+
+	if (intr_context ())
+		intr_yield_on_return ();
+	else
+		thread_yield ();
+}
+
+/* Changes the effective priority of T to PRIORITY, e.g. because
+   of a priority donation.  If T is waiting in a ready queue, it
+   is moved to the tail of the queue for its new priority. */
+void
+thread_update_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	if (t->priority != priority) {
+		if (t->status == THREAD_READY) {
+			ready_queue_remove (t);
+			t->priority = priority;
+			ready_queue_push (t);
+		} else
+			t->priority = priority;
 	}
-	thread_current()->priority = max_priority;
-	donate_priority();
+	intr_set_level (old_level);
+}
 
-	if (new_priority < list_entry( list_begin(&ready_list),struct thread, elem)->priority)
-	thread_yield();
+/* Recomputes the effective priority of T as the greater of its
+   own priority and the priorities donated to it through the
+   locks and reader-writer locks it holds.  The top of T's
+   held_locks heap gives the former in constant time.  Returns
+   true if T's priority changed. */
+bool
+thread_refresh_priority (struct thread *t) {
+	int priority = t->priority_origin;
+	enum intr_level old_level;
+
+	ASSERT (is_thread (t));
+
+	old_level = intr_disable ();
+	if (!heap_empty (&t->held_locks)) {
+		struct lock *top = heap_entry (heap_top (&t->held_locks),
+				struct lock, elem);
+		if (top->priority > priority)
+			priority = top->priority;
+	}
+	if (rwlock_donated_priority (t) > priority)
+		priority = rwlock_donated_priority (t);
+	intr_set_level (old_level);
+
+	if (priority == t->priority)
+		return false;
+	thread_update_priority (t, priority);
+	return true;
 }
 
 /* Returns the current thread's priority. */
@@ -361,47 +590,129 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority.  Yields if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	old_level = intr_disable ();
+	curr->nice = nice;
+	if (thread_mlfqs)
+		curr->priority = mlfqs_priority (curr);
+	intr_set_level (old_level);
+
+	thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+	return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int recent_cpu_100 = fp_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+	intr_set_level (old_level);
+	return recent_cpu_100;
+}
+
+/* Returns the 4.4BSD priority of T, computed from its recent_cpu
+   and nice values. */
+static int
+mlfqs_priority (const struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	if (priority < PRI_MIN)
+		return PRI_MIN;
+	if (priority > PRI_MAX)
+		return PRI_MAX;
+	return priority;
+}
+
+/* Updates the 4.4BSD scheduler state at a timer tick, with T the
+   running thread.
+
+   Only the running thread's recent_cpu changes from tick to
+   tick, so only its priority is recomputed every
+   MLFQS_PRI_INTERVAL ticks.  Once per second the load average and
+   every thread's recent_cpu decay, and all priorities are
+   recomputed; threads whose priority changed just move to another
+   ready queue, so nothing is ever sorted. */
+static void
+mlfqs_tick (struct thread *t) {
+	int64_t ticks = timer_ticks ();
+
+	ASSERT (intr_context ());
+
+	if (!is_idle (t))
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+	if (ticks % TIMER_FREQ == 0) {
+		int ready_threads = 0;
+		fixed_t coef;
+		struct list_elem *e;
+
+		for (int i = 0; i < cpu_cnt; i++)
+			if (cpus[i].online)
+				ready_threads += cpus[i].rq.cnt
+					+ (cpus[i].curr != cpus[i].idle ? 1 : 0);
+
+		load_avg = fp_add (fp_mul (fp_div_int (fp_from_int (59), 60), load_avg),
+				fp_mul_int (fp_div_int (fp_from_int (1), 60), ready_threads));
+		coef = fp_div (fp_mul_int (load_avg, 2),
+				fp_add_int (fp_mul_int (load_avg, 2), 1));
+
+		for (e = list_begin (&all_list); e != list_end (&all_list);
+				e = list_next (e)) {
+			struct thread *th = list_entry (e, struct thread, all_elem);
+			if (is_idle (th))
+				continue;
+			th->recent_cpu = fp_add_int (fp_mul (coef, th->recent_cpu), th->nice);
+			thread_update_priority (th, mlfqs_priority (th));
+		}
+		thread_preempt ();
+	} else if (ticks % MLFQS_PRI_INTERVAL == 0 && !is_idle (t)) {
+		t->priority = mlfqs_priority (t);
+		thread_preempt ();
+	}
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes its CPU's `idle' member, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never
+   appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when its CPU's run
+   queue is empty. */
 static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current ();
+	this_cpu ()->idle = thread_current ();
 	sema_up (idle_started);
 
 	for (;;) {
@@ -440,6 +751,8 @@ kernel_thread (thread_func *function, void *aux) {
    NAME. */
 static void
 init_thread (struct thread *t, const char *name, int priority) {
+	enum intr_level old_level;
+
 	ASSERT (t != NULL);
 	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT (name != NULL);
@@ -454,7 +767,8 @@ init_thread (struct thread *t, const char *name, int priority) {
 	
 	t->priority_origin =priority;
 	t->wait_on_lock =NULL;
-	list_init(&t->donation);
+	t->wait_on_rwlock = NULL;
+	heap_init (&t->held_locks, lock_priority_less, NULL);
 
 
 	list_init(&t->child_list);
@@ -469,19 +783,93 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->load_status = 0;
 
 	t->running_file = NULL; //#diff, added 23:22
+
+	t->nice = 0;
+	t->recent_cpu = 0;
+	t->cpu = this_cpu ();
+
+	/* mlfqs_tick() walks ALL_LIST from the timer interrupt. */
+	old_level = intr_disable ();
+	list_push_back (&all_list, &t->all_elem);
+	intr_set_level (old_level);
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Chooses and returns the next thread to be scheduled on CPU.
+   Should return a thread from CPU's run queue, unless the run
+   queue is empty.  (If the running thread can continue running,
+   then it will be in the run queue.)  If the run queue is empty,
+   return CPU's idle thread. */
 static struct thread *
-next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+next_thread_to_run (struct cpu *cpu) {
+	struct thread *next = ready_queue_pop (cpu);
+
+	return next != NULL ? next : cpu->idle;
+}
+
+/* Appends T to the ready queue for its priority in the run queue
+   of T's CPU. */
+static void
+ready_queue_push (struct thread *t) {
+	struct runqueue *rq = &t->cpu->rq;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_READY);
+
+	spinlock_acquire (&rq->lock);
+	list_push_back (&rq->queues[t->priority], &t->elem);
+	rq->bitmap |= 1ULL << t->priority;
+	rq->cnt++;
+	spinlock_release (&rq->lock);
+}
+
+/* Removes T, which must be in a ready queue, from it. */
+static void
+ready_queue_remove (struct thread *t) {
+	struct runqueue *rq = &t->cpu->rq;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (t->status == THREAD_READY);
+
+	spinlock_acquire (&rq->lock);
+	list_remove (&t->elem);
+	if (list_empty (&rq->queues[t->priority]))
+		rq->bitmap &= ~(1ULL << t->priority);
+	rq->cnt--;
+	spinlock_release (&rq->lock);
+}
+
+/* Removes and returns the first thread of the highest-priority
+   nonempty ready queue of CPU, or a null pointer if CPU has no
+   ready thread. */
+static struct thread *
+ready_queue_pop (struct cpu *cpu) {
+	struct runqueue *rq = &cpu->rq;
+	struct thread *t = NULL;
+	int pri;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&rq->lock);
+	pri = ready_queue_max_priority (cpu);
+	if (pri >= PRI_MIN) {
+		t = list_entry (list_pop_front (&rq->queues[pri]), struct thread, elem);
+		if (list_empty (&rq->queues[pri]))
+			rq->bitmap &= ~(1ULL << pri);
+		rq->cnt--;
+	}
+	spinlock_release (&rq->lock);
+	return t;
+}
+
+/* Returns the priority of the highest-priority thread ready to
+   run on CPU, or PRI_MIN - 1 if no thread is ready. */
+static int
+ready_queue_max_priority (struct cpu *cpu) {
+	uint64_t bitmap = cpu->rq.bitmap;
+
+	if (bitmap == 0)
+		return PRI_MIN - 1;
+	return 63 - __builtin_clzll (bitmap);
 }
 
 /* Use iretq to launch the thread */
@@ -581,6 +969,27 @@ thread_launch (struct thread *th) {
 			);
 }
 
+/* Frees the pages of the threads that schedule() queued for
+   destruction.  Freeing a page may block on the page allocator's
+   lock, so this is done here, from thread_create() and
+   thread_exit(), rather than inside the scheduler with
+   interrupts off. */
+static void
+reap_dying_threads (void) {
+	for (;;) {
+		struct thread *victim = NULL;
+		enum intr_level old_level = intr_disable ();
+
+		if (!list_empty (&destruction_req))
+			victim = list_entry (list_pop_front (&destruction_req),
+					struct thread, elem);
+		intr_set_level (old_level);
+		if (victim == NULL)
+			break;
+		palloc_free_page (victim);
+	}
+}
+
 /* Schedules a new process. At entry, interrupts must be off.
  * This function modify current thread's status to status and then
  * finds another thread to run and switches to it.
@@ -589,28 +998,28 @@ static void
 do_schedule(int status) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
-	while (!list_empty (&destruction_req)) {
-		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
-		palloc_free_page(victim);
-	}
 	thread_current ()->status = status;
 	schedule ();
 }
 
 static void
 schedule (void) {
+	struct cpu *cpu = this_cpu ();
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+	struct thread *next = next_thread_to_run (cpu);
 
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (curr->status != THREAD_RUNNING);
 	ASSERT (is_thread (next));
+	sched_account (cpu, curr, next);
+
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
+	next->cpu = cpu;
+	cpu->curr = next;
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	cpu->slice_ticks = 0;
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -623,8 +1032,7 @@ schedule (void) {
 		   pull out the rug under itself.
 		   We just queuing the page free reqeust here because the page is
 		   currently used by the stack.
-		   The real destruction logic will be called at the beginning of the
-		   schedule(). */
+		   The real destruction logic is in reap_dying_threads(). */
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
 			ASSERT (curr != next);
 			list_push_back (&destruction_req, &curr->elem);
@@ -632,10 +1040,53 @@ schedule (void) {
 
 		/* Before switching the thread, we first save the information
 		 * of current running. */
+		cpu->switch_cnt++;
+		fpu_switch_out (curr);
 		thread_launch (next);
 	}
 }
 
+/* Notes that T, now THREAD_READY, starts waiting to run.  WAKEUP
+   is true if T was blocked, false if it was running. */
+static void
+sched_ready (struct thread *t, bool wakeup) {
+	t->ready_tsc = rdtsc ();
+	t->woken = wakeup;
+}
+
+/* Updates the scheduling statistics of CURR, NEXT and CPU for a
+   switch from CURR to NEXT.  Idle threads are not counted: they
+   wait for nothing and switching away from them is free. */
+static void
+sched_account (struct cpu *cpu, struct thread *curr, struct thread *next) {
+	if (curr != next && !is_idle (curr)) {
+		if (curr->status == THREAD_READY) {
+			curr->sched.involuntary++;
+			cpu->sched.involuntary++;
+		} else {
+			curr->sched.voluntary++;
+			cpu->sched.voluntary++;
+		}
+	}
+
+	if (!is_idle (next)) {
+		uint64_t wait = rdtsc () - next->ready_tsc;
+
+		next->sched.wait += wait;
+		cpu->sched.wait += wait;
+		if (next->woken) {
+			int bucket = wait != 0 ? 63 - __builtin_clzll (wait) : 0;
+
+			if (bucket >= SCHED_LATENCY_BUCKETS)
+				bucket = SCHED_LATENCY_BUCKETS - 1;
+			next->sched.latency[bucket]++;
+			next->sched.wakeups++;
+			cpu->sched.latency[bucket]++;
+			cpu->sched.wakeups++;
+		}
+	}
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) {
@@ -649,53 +1100,120 @@ allocate_tid (void) {
 	return tid;
 }
 
-//#diff, but hmm... 
-void thread_sleep(int64_t ticks){
-	/* if the current thread is not idle thread,
-		  change the state of the caller thread to BLOCKED,
-			store the local tick to wake up, 
-			update the global tick if necessary,
-			and call schedule() */
-	struct thread* current_thread = thread_current();
+/* Puts the current thread to sleep until timer tick TICKS.
+   Called by timer_sleep() with interrupts on. */
+void
+thread_sleep (int64_t ticks) {
+	struct thread *curr = thread_current ();
 	enum intr_level old_level;
-	old_level = intr_disable ();	// interrupt disable
-	if (current_thread!=idle_thread){
-		current_thread->wakeup_tick = ticks;
-		list_insert_ordered(&sleep_list, &(current_thread->elem),less_wakeuptick,NULL);// sleep list에 삽입
-		
-		thread_save_mintick();
-		thread_block();
-		intr_set_level (old_level);
+
+	ASSERT (!intr_context ());
+
+	old_level = intr_disable ();
+	if (!is_idle (curr)) {
+		curr->wakeup_tick = ticks;
+		sleep_wheel_insert (curr, wheel_next_tick);
+		sleeper_cnt++;
+		thread_block ();
 	}
-}   
+	intr_set_level (old_level);
+}
 
-void thread_wakeup(int64_t ticks){
-	struct list_elem *last;
+/* Advances the sleep wheel up to timer tick TICKS and moves every
+   thread whose wakeup time has come into the ready queues.
+   Called by the timer interrupt handler on each tick, so the
+   common case -- nobody sleeping, or nobody due this tick -- must
+   return right away. */
+void
+thread_wakeup (int64_t ticks) {
+	bool preempt = false;
 
-	for (last = list_begin(&sleep_list); last != list_end(&sleep_list); last = list_next(last)) {
-		if (ticks < list_entry(last, struct thread, elem)->wakeup_tick)
-			break;
+	ASSERT (intr_context ());
+
+	if (sleeper_cnt == 0) {
+		wheel_next_tick = ticks + 1;
+		return;
 	}
 
-	list_splice(list_end(&ready_list), list_begin(&sleep_list), last);
-	list_sort(&ready_list, less_priority, NULL);
+	while (wheel_next_tick <= ticks) {
+		if (sleep_wheel_expire (wheel_next_tick))
+			preempt = true;
+		wheel_next_tick++;
+	}
+
+	if (preempt)
+		intr_yield_on_return ();
 }
 
-void thread_save_mintick(){
-	struct thread* thread_first = list_entry(list_begin(&sleep_list),struct thread, elem);
-	min_wakeup_tick = thread_first->wakeup_tick;
-	return;
+/* Adds T to the slot of the sleep wheel for T->wakeup_tick,
+   given that NEXT_TICK is the first tick the wheel has not yet
+   processed.  Threads whose wakeup time has already passed go to
+   NEXT_TICK's slot. */
+static void
+sleep_wheel_insert (struct thread *t, int64_t next_tick) {
+	int64_t expires = t->wakeup_tick > next_tick ? t->wakeup_tick : next_tick;
+	int64_t delta = expires - next_tick;
+	struct list *slot;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (delta < WHEEL_SIZE)
+		slot = &sleep_wheel0[expires & WHEEL_MASK];
+	else if (delta < WHEEL_SIZE * WHEEL_SIZE)
+		slot = &sleep_wheel1[(expires >> WHEEL_BITS) & WHEEL_MASK];
+	else
+		slot = &sleep_overflow;
+	list_push_back (slot, &t->elem);
 }
 
-int64_t thread_get_mintick(){
-	return min_wakeup_tick;
+/* Re-inserts every thread on SLOT relative to NEXT_TICK. */
+static void
+sleep_wheel_cascade (struct list *slot, int64_t next_tick) {
+	struct list pending;
+
+	if (list_empty (slot))
+		return;
+
+	list_init (&pending);
+	list_splice (list_end (&pending), list_begin (slot), list_end (slot));
+	while (!list_empty (&pending))
+		sleep_wheel_insert (list_entry (list_pop_front (&pending),
+					struct thread, elem), next_tick);
 }
 
+/* Processes timer tick TICK: cascades the outer levels of the
+   wheel if TICK is on their boundary, then moves all threads in
+   TICK's level-0 slot to the ready queues in the order they went
+   to sleep.  Returns true if one of them should preempt the
+   running thread. */
+static bool
+sleep_wheel_expire (int64_t tick) {
+	struct list *slot = &sleep_wheel0[tick & WHEEL_MASK];
+	int max_priority = PRI_MIN - 1;
+
+	if ((tick & WHEEL_MASK) == 0) {
+		if (((tick >> WHEEL_BITS) & WHEEL_MASK) == 0)
+			sleep_wheel_cascade (&sleep_overflow, tick);
+		sleep_wheel_cascade (&sleep_wheel1[(tick >> WHEEL_BITS) & WHEEL_MASK],
+				tick);
+	}
 
-bool less_wakeuptick(const struct list_elem *a, const struct list_elem *b, void *aux){
-	struct thread* thread_a = list_entry(a,struct thread, elem);
-	struct thread* thread_b = list_entry(b,struct thread, elem);
-	return (int64_t)(thread_a->wakeup_tick)	< (int64_t)(thread_b->wakeup_tick);
+	while (!list_empty (slot)) {
+		struct thread *t = list_entry (list_pop_front (slot), struct thread, elem);
+
+		ASSERT (t->status == THREAD_BLOCKED);
+		ASSERT (t->wakeup_tick <= tick);
+		sleeper_cnt--;
+		t->status = THREAD_READY;
+		sched_ready (t, true);
+		ready_queue_push (t);
+		if (t->cpu == this_cpu () && t->priority > max_priority)
+			max_priority = t->priority;
+	}
+	if (max_priority < PRI_MIN)
+		return false;
+	return is_idle (thread_current ())
+		|| max_priority > thread_current ()->priority;
 }
 
 bool less_priority(const struct list_elem *a, const struct list_elem *b, void *aux){
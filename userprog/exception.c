@@ -2,6 +2,8 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/uaccess.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "intrinsic.h"
@@ -10,6 +12,7 @@
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
+static void device_not_available (struct intr_frame *);
 static void page_fault (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
@@ -45,7 +48,7 @@ exception_init (void) {
 	intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
 	intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
 	intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-	intr_register_int (7, 0, INTR_ON, kill,
+	intr_register_int (7, 0, INTR_ON, device_not_available,
 			"#NM Device Not Available Exception");
 	intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
 	intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
@@ -105,6 +108,17 @@ kill (struct intr_frame *f) {
 	}
 }
 
+/* Device-not-available handler.  A user process used the FPU or
+   SSE for the first time since it was switched in, so give it
+   its FPU state and restart the instruction.  See threads/fpu.c.
+   The kernel does not use the FPU, so #NM from kernel code is a
+   bug. */
+static void
+device_not_available (struct intr_frame *f) {
+	if (f->cs != SEL_UCSEG || !fpu_trap ())
+		kill (f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -140,16 +154,21 @@ page_fault (struct intr_frame *f) {
 	write = (f->error_code & PF_W) != 0;
 	user = (f->error_code & PF_U) != 0;
 
-#ifdef USERPROG
-	exit(-1);
-#endif
-
 #ifdef VM
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
 		return;
 #endif
 
+	/* The kernel faulted in one of the user memory copy routines,
+	   which know how to fail gracefully. */
+	if (!user && uaccess_fixup (f))
+		return;
+
+#ifdef USERPROG
+	exit(-1);
+#endif
+
 	/* Count page faults. */
 	page_fault_cnt++;
 
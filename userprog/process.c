@@ -11,8 +11,10 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -102,6 +104,8 @@ process_fork (const char *name, struct intr_frame *if_ UNUSED) {
 	/* Clone current thread to new thread.*/
 	// memcpy(&thread_current()->iff_, if_,sizeof(struct intr_frame));
 	memcpy(&thread_current()->iff_, if_,sizeof(struct intr_frame));
+	/* The child copies our FPU state, maybe while we still run. */
+	fpu_save ();
 
 	int tid = thread_create (name,	PRI_DEFAULT, __do_fork, thread_current());
 
@@ -179,6 +183,8 @@ __do_fork (void *aux) {
 		goto error;
 
 	process_activate (current);
+	if (!fpu_copy (current, parent))
+		goto error;
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
@@ -233,6 +239,7 @@ process_exec (void *f_name) {
 
 	/* We first kill the current context */
 	process_cleanup ();
+	fpu_release (thread_current ());
 
 	// char *token, *save_ptr;
 	// token = strtok_r(file_name, " ", &save_ptr);
@@ -719,11 +726,24 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
+/* Where lazy_load_segment() finds a page's contents.  FILE is
+ * the executable, which stays open until the process exits. */
+struct segment_aux {
+	struct file *file;
+	off_t ofs;
+	size_t read_bytes;
+};
+
 static bool
 lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+	struct segment_aux *seg = aux;
+	uint8_t *kva = page->frame->kva;
+
+	if (file_read_at (seg->file, kva, seg->read_bytes, seg->ofs)
+			!= (off_t) seg->read_bytes)
+		return false;
+	memset (kva + seg->read_bytes, 0, PGSIZE - seg->read_bytes);
+	return true;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -754,16 +774,23 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
+		struct segment_aux *aux = malloc (sizeof *aux);
+		if (aux == NULL)
+			return false;
+		aux->file = file;
+		aux->ofs = ofs;
+		aux->read_bytes = page_read_bytes;
 		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+					writable, lazy_load_segment, aux)) {
+			free (aux);
 			return false;
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+		ofs += page_read_bytes;
 	}
 	return true;
 }
@@ -774,11 +801,12 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
-
+	/* VM_MARKER_0 marks the page as stack. */
+	if (vm_alloc_page (VM_ANON | VM_MARKER_0, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 	return success;
 }
 #endif /* VM */
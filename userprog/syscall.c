@@ -13,12 +13,17 @@
 #include "devices/input.h"
 #include "lib/string.h"
 #include "threads/palloc.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
 
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
+struct rwlock filesys_lock;
+
 void halt(void);
 
 int exit (int status);
@@ -35,6 +40,23 @@ int write (int fd, const void *buffer, unsigned size);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int sched_stats (struct sched_stats *stats, int cnt);
+
+/* Longest file name accepted from a user process, counting the
+   null terminator. */
+#define PATH_MAX 128
+
+/* Copies the user string USTR, a file name, into BUF, which has
+   room for PATH_MAX bytes.  Kills the process if USTR is not
+   mapped.  Returns false if USTR is too long. */
+static bool
+get_user_path (char *buf, const char *ustr)
+{
+	int64_t len = strncpy_from_user (buf, ustr, PATH_MAX);
+	if (len < 0)
+		exit(-1);
+	return len < PATH_MAX;
+}
 
 /* System call.
  *
@@ -61,7 +83,7 @@ syscall_init (void) {
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
 
-	lock_init(&filesys_lock);
+	rwlock_init (&filesys_lock);
 }
 
 /* The main system call interface */
@@ -154,6 +176,11 @@ syscall_handler (struct intr_frame *f UNUSED) {
 				close(f->R.rdi);
 				break;
 			}
+		case SYS_SCHED_STATS:            /* Read scheduling statistics. */
+			{// int sched_stats (struct sched_stats *stats, int cnt)
+				f->R.rax = sched_stats((struct sched_stats *) f->R.rdi, f->R.rsi);
+				break;
+			}
 		default: thread_exit ();
 	}
 }
@@ -196,6 +223,12 @@ int exit (int status)
 
 int fork (const char *thread_name, struct intr_frame *f)
 {
+	char name[16];
+
+	if (strncpy_from_user (name, thread_name, sizeof name) < 0)
+		exit(-1);
+	name[sizeof name - 1] = '\0';
+
 	/* TODO: thread_name이라는 이름으로 현재 프로세스의 복사본인 새 프로세스를 만듦.
 	 * callee-saved 레지스터인 %RBX, %RSP, %RBP, and %R12 - %R15 외의 레지스터의
 	 * 값을 복사할 필요 없음. 자식 프로세스의 pid를 return해야하고 그 외에는
@@ -207,7 +240,7 @@ int fork (const char *thread_name, struct intr_frame *f)
 	 * threads/mmu.c의 pml4_for_each()를 사용하여 전체 유저 메모리 공간을 복사하게 되어있지만,
 	 * 전달된 pte_for_each_func의 빈 부분을 채워넣어야 한다.
 	 */
-	return process_fork(thread_name,f);
+	return process_fork(name,f);
 	
 }
 
@@ -231,7 +264,11 @@ int exec(const char *cmd_line)
 	if (fn_copy == NULL) //@@added 16:26_2
 		exit(-1);
 
-	strlcpy (fn_copy, cmd_line, PGSIZE);
+	if (strncpy_from_user (fn_copy, cmd_line, PGSIZE) < 0) {
+		palloc_free_page (fn_copy);
+		exit(-1);
+	}
+	fn_copy[PGSIZE - 1] = '\0';
 	if(process_exec(fn_copy)==-1) {
 		// palloc_free_page(fn_copy); //@@added for free
 		// exit(-1); //@@deldted 16:25_1
@@ -266,13 +303,26 @@ int wait(int pid)
 
 bool create (const char *file, unsigned initial_size)
 {
-	if (file==NULL) exit(-1);
-	return filesys_create(file, initial_size);
+	char name[PATH_MAX];
+
+	if (!get_user_path (name, file))
+		return false;
+	rwlock_acquire_exclusive (&filesys_lock);
+	bool success = filesys_create(name, initial_size);
+	rwlock_release_exclusive (&filesys_lock);
+	return success;
 }
 
 bool remove (const char *file)
 {
-	return filesys_remove(file);
+	char name[PATH_MAX];
+
+	if (!get_user_path (name, file))
+		return false;
+	rwlock_acquire_exclusive (&filesys_lock);
+	bool success = filesys_remove(name);
+	rwlock_release_exclusive (&filesys_lock);
+	return success;
 }
 
 int set_fd(struct file* f){
@@ -301,8 +351,11 @@ int open (const char *file){
 	 * 한 file에 대한 서로 다른 파일 디스크립터는 각각 독립적으로 닫히고,
 	 * file position을 공유하지 않음
 	 */
-	if (file==NULL) return -1;
-	struct file *new_file = filesys_open(file);
+	char name[PATH_MAX];
+
+	if (!get_user_path (name, file))
+		return -1;
+	struct file *new_file = filesys_open(name);
 	if (new_file==NULL) return -1;
 	int fd = set_fd(new_file);
 	return fd;
@@ -315,49 +368,91 @@ int filesize (int fd)
 	return file_length(f);
 }
 
+/* Reads and writes move data between the file and user memory a
+ * page at a time through a kernel bounce page, so that a bad user
+ * buffer faults in copy_to_user() or copy_from_user(), with no
+ * lock held, rather than deep inside the file system. */
+
 int read (int fd, void *buffer, unsigned size)
 {
 	//실패하면 -1 return -> 언제 실패하지?
 	// fd가 유효하지 않을 때? (연결된 파일이 없을때?)
-	if(fd == STDIN_FILENO){
-		int i;
-		for (i=0;i<size;i++){
-			input_getc();
-		}
-		return size;
-	}
-	else if (fd==STDOUT_FILENO){
+	struct file *f = NULL;
+	uint8_t *bounce;
+	unsigned done = 0;
+
+	if (fd==STDOUT_FILENO)
 		return -1;
-	}
-	else {
-		struct file* f = (thread_current()->fdt)[fd];
+	if (fd != STDIN_FILENO) {
+		f = (thread_current()->fdt)[fd];
 		if (f==NULL) return -1;
-		// lock_acquire(&filesys_lock); //@@added 16:58
-		off_t ans = file_read(f,buffer,size);
-		// lock_release(&filesys_lock); //@@added 16:58
-		return ans;
 	}
+
+	bounce = palloc_get_page (0);
+	if (bounce == NULL)
+		return -1;
+	while (done < size) {
+		unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+		unsigned n;
+
+		if (f == NULL) {
+			for (n = 0; n < chunk; n++)
+				bounce[n] = input_getc();
+		} else {
+			rwlock_acquire_shared (&filesys_lock);
+			n = file_read(f, bounce, chunk);
+			rwlock_release_shared (&filesys_lock);
+		}
+		if (copy_to_user ((uint8_t *) buffer + done, bounce, n) < 0) {
+			palloc_free_page (bounce);
+			exit(-1);
+		}
+		done += n;
+		if (n < chunk)
+			break;
+	}
+	palloc_free_page (bounce);
+	return done;
 }
 
 int write (int fd, const void *buffer, unsigned size)
 {	
-	if (fd==STDIN_FILENO) {
+	struct file *f = NULL;
+	uint8_t *bounce;
+	unsigned done = 0;
+
+	if (fd==STDIN_FILENO)
 		return -1;
+	if (fd != STDOUT_FILENO) {
+		f = thread_current()->fdt[fd];
+		if (f==NULL) return -1;
 	}
-	else if (fd==STDOUT_FILENO){
-		// lock_acquire(&filesys_lock); //@@added 16:59
-		putbuf(buffer,size);
-		// lock_release(&filesys_lock); //@@added 16:59
-		return size;
-	}
-	else {
-		lock_acquire(&filesys_lock); //@@deleted
-		struct file* f = thread_current()->fdt[fd];
-		// if (f==NULL) return -1; //@@added 17:00
-		off_t val = file_write(f, buffer, size);
-		lock_release(&filesys_lock); //@@deleted
-		return val;
+
+	bounce = palloc_get_page (0);
+	if (bounce == NULL)
+		return -1;
+	while (done < size) {
+		unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+		unsigned n;
+
+		if (copy_from_user (bounce, (const uint8_t *) buffer + done, chunk) < 0) {
+			palloc_free_page (bounce);
+			exit(-1);
+		}
+		if (f == NULL) {
+			putbuf((const char *) bounce, chunk);
+			n = chunk;
+		} else {
+			rwlock_acquire_exclusive (&filesys_lock);
+			n = file_write(f, bounce, chunk);
+			rwlock_release_exclusive (&filesys_lock);
+		}
+		done += n;
+		if (n < chunk)
+			break;
 	}
+	palloc_free_page (bounce);
+	return done;
 }
 
 void seek (int fd, unsigned position)
@@ -381,4 +476,31 @@ void close (int fd)
 	// if(f==NULL) return; //@@added 17:05_2
 	file_close(f);
 	thread_current()->fdt[fd]=NULL;
-}
\ No newline at end of file
+}
+
+/* Most records sched_stats() returns in one call. */
+#define SCHED_STATS_MAX 256
+
+int sched_stats (struct sched_stats *stats, int cnt)
+{
+	/* thread_sched_stats() runs with interrupts off, so it must
+	 * not touch user memory: gather into a kernel buffer first. */
+	struct sched_stats *buf;
+	int n;
+
+	if (cnt <= 0)
+		return 0;
+	if (cnt > SCHED_STATS_MAX)
+		cnt = SCHED_STATS_MAX;
+
+	buf = malloc (cnt * sizeof *buf);
+	if (buf == NULL)
+		return -1;
+	n = thread_sched_stats (buf, cnt);
+	if (copy_to_user (stats, buf, n * sizeof *buf) < 0) {
+		free (buf);
+		exit(-1);
+	}
+	free (buf);
+	return n;
+}
@@ -0,0 +1,167 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/vm.h"
+#endif
+
+/* Copying to and from user memory.
+
+   The routines below touch user memory directly, at the speed
+   of memcpy(), instead of looking up every page first.  Each
+   instruction that may fault on a user address is listed in the
+   exception table, the __ex_table section, together with a fixup
+   address to resume at.  When such an instruction faults,
+   page_fault() calls uaccess_fixup(), which points the
+   interrupted frame at the fixup, and the copy returns -EFAULT
+   instead of the fault killing the kernel.
+
+   The exception table is assembled from the entries below and
+   gathered by kernel.lds.S between _start_ex_table and
+   _end_ex_table. */
+
+/* An exception table entry. */
+struct ex_entry {
+	uintptr_t insn;             /* Instruction that may fault. */
+	uintptr_t fixup;            /* Where to resume if it does. */
+};
+
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Returns true if [UADDR, UADDR + SIZE) lies entirely in user
+   virtual memory. */
+static bool
+user_range_ok (const void *uaddr, size_t size) {
+	return is_user_vaddr (uaddr) && size <= KERN_BASE - (uintptr_t) uaddr;
+}
+
+/* Copies SIZE bytes from SRC to DST, 8 bytes at a time.  Returns
+   the number of bytes left uncopied because of a fault, which is
+   0 if the copy completed. */
+static size_t
+copy_user (void *dst, const void *src, size_t size) {
+	size_t cnt = size / 8;
+	size_t tail = size % 8;
+
+	asm volatile ("1:	rep movsq\n"
+			"	mov %[tail], %%rcx\n"
+			"2:	rep movsb\n"
+			"3:\n"
+			"	.pushsection .text.fixup, \"ax\"\n"
+			"4:	lea (%[tail], %%rcx, 8), %%rcx\n"
+			"	jmp 3b\n"
+			"	.popsection\n"
+			"	.pushsection __ex_table, \"a\"\n"
+			"	.quad 1b, 4b, 2b, 3b\n"
+			"	.popsection\n"
+			: "+D" (dst), "+S" (src), "+c" (cnt)
+			: [tail] "r" (tail)
+			: "memory");
+	return cnt;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.
+   Returns 0 if successful or -EFAULT if any byte of USRC is not
+   mapped into the current process. */
+int
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	if (!user_range_ok (usrc, size))
+		return -EFAULT;
+	return copy_user (dst, usrc, size) == 0 ? 0 : -EFAULT;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.
+   Returns 0 if successful or -EFAULT if any byte of UDST is not
+   mapped writable into the current process. */
+int
+copy_to_user (void *udst, const void *src, size_t size) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	uint8_t *upage;
+
+	if (!user_range_ok (udst, size))
+		return -EFAULT;
+
+	/* Ring 0 ignores read-only PTEs, because CR0.WP is clear, so
+	   check writability here, and take the write fault that the
+	   user would have taken on a copy-on-write page.  Missing pages
+	   fault and are fixed up below. */
+	if (size > 0)
+		for (upage = pg_round_down (udst);
+				upage < (uint8_t *) udst + size; upage += PGSIZE) {
+			uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 0);
+			if (pte != NULL && (*pte & PTE_P) && !is_writable (pte)) {
+#ifdef VM
+				if (!vm_try_handle_fault (NULL, upage, false, true, false))
+#endif
+					return -EFAULT;
+			}
+		}
+
+	return copy_user (udst, src, size) == 0 ? 0 : -EFAULT;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns the length of the
+   string, not counting the null terminator, if it fits.  Returns
+   SIZE, leaving DST unterminated, if it does not, or -EFAULT if
+   the string is not all mapped into the current process. */
+int64_t
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	char *d = dst;
+	size_t max, left;
+	int64_t err = 0;
+
+	if (!is_user_vaddr (usrc))
+		return -EFAULT;
+
+	/* Stop at the end of user memory. */
+	max = size;
+	if (max > KERN_BASE - (uintptr_t) usrc)
+		max = KERN_BASE - (uintptr_t) usrc;
+	left = max;
+
+	asm volatile ("1:	test %%rcx, %%rcx\n"
+			"	jz 3f\n"
+			"2:	lodsb\n"
+			"	stosb\n"
+			"	dec %%rcx\n"
+			"	test %%al, %%al\n"
+			"	jnz 1b\n"
+			"3:\n"
+			"	.pushsection .text.fixup, \"ax\"\n"
+			"4:	mov %[efault], %[err]\n"
+			"	jmp 3b\n"
+			"	.popsection\n"
+			"	.pushsection __ex_table, \"a\"\n"
+			"	.quad 2b, 4b\n"
+			"	.popsection\n"
+			: "+D" (d), "+S" (usrc), "+c" (left), [err] "+r" (err)
+			: [efault] "i" (-EFAULT)
+			: "rax", "memory");
+	if (err != 0)
+		return err;
+
+	if (d > dst && d[-1] == '\0')
+		return d - dst - 1;
+
+	/* A string that runs into kernel memory is as bad as one that
+	   runs into an unmapped page. */
+	return max < size ? -EFAULT : (int64_t) size;
+}
+
+/* Called by page_fault() for a fault in kernel mode.  If F's
+   instruction is in the exception table, resumes F at its fixup
+   and returns true.  Otherwise returns false. */
+bool
+uaccess_fixup (struct intr_frame *f) {
+	const struct ex_entry *e;
+
+	for (e = _start_ex_table; e < _end_ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
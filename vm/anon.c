@@ -1,7 +1,14 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include <stdio.h>
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,36 +24,223 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap space.
+ *
+ * The swap disk is divided into slots of SLOT_SECTORS sectors,
+ * one page each, and each page moves to or from its slot with a
+ * single multi-sector disk command.  A forked child shares the
+ * slots of its parent's swapped-out pages instead of reading them
+ * in, so each slot has a reference count, and a slot is free when
+ * its count drops to zero.  The bitmap mirrors which counts are
+ * nonzero so that free slots can be found quickly. */
+#define SLOT_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct bitmap *swap_map;         /* Slots in use. */
+static unsigned *swap_refs;             /* References to each slot. */
+static struct lock swap_lock;           /* Guards swap_map, swap_refs. */
+
+/* Swap statistics, in TSC cycles for the latencies. */
+static long long swap_in_cnt;           /* Pages read in. */
+static long long swap_out_cnt;          /* Pages written out. */
+static long long swap_clean_cnt;        /* Evictions that needed no write. */
+static uint64_t swap_in_cycles, swap_in_max;
+static uint64_t swap_out_cycles, swap_out_max;
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	size_t slot_cnt;
+
+	swap_disk = disk_get (1, 1);
+	lock_init (&swap_lock);
+	if (swap_disk == NULL)
+		return;
+
+	slot_cnt = disk_size (swap_disk) / SLOT_SECTORS;
+	swap_map = bitmap_create (slot_cnt);
+	swap_refs = calloc (slot_cnt, sizeof *swap_refs);
+	if (swap_map == NULL || swap_refs == NULL)
+		PANIC ("cannot allocate %zu swap slots", slot_cnt);
+}
+
+/* Allocates a swap slot with one reference.  Returns the slot, or
+ * SWAP_NONE if there is no swap disk or it is full. */
+static size_t
+slot_alloc (void) {
+	size_t slot;
+
+	if (swap_map == NULL)
+		return SWAP_NONE;
+	lock_acquire (&swap_lock);
+	slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+	if (slot != BITMAP_ERROR)
+		swap_refs[slot] = 1;
+	else
+		slot = SWAP_NONE;
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Adds a reference to SLOT. */
+static void
+slot_ref (size_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (swap_refs[slot] > 0);
+	swap_refs[slot]++;
+	lock_release (&swap_lock);
+}
+
+/* Drops a reference to SLOT, freeing it with the last one.
+ * Returns true if SLOT was freed. */
+static bool
+slot_unref (size_t slot) {
+	bool freed;
+
+	lock_acquire (&swap_lock);
+	ASSERT (swap_refs[slot] > 0);
+	freed = --swap_refs[slot] == 0;
+	if (freed)
+		bitmap_reset (swap_map, slot);
+	lock_release (&swap_lock);
+	return freed;
+}
+
+/* Returns true if SLOT has other references than the caller's. */
+static bool
+slot_shared (size_t slot) {
+	bool shared;
+
+	lock_acquire (&swap_lock);
+	shared = swap_refs[slot] > 1;
+	lock_release (&swap_lock);
+	return shared;
+}
+
+/* Records a swap transfer that started at START in the counters
+ * CYCLES and MAX. */
+static void
+account (uint64_t start, uint64_t *cycles, uint64_t *max) {
+	uint64_t elapsed = rdtsc () - start;
+
+	*cycles += elapsed;
+	if (elapsed > *max)
+		*max = elapsed;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) {
+	printf ("Swap: %lld pages in, %lld out, %lld clean evictions\n",
+			swap_in_cnt, swap_out_cnt, swap_clean_cnt);
+	if (swap_in_cnt > 0)
+		printf ("Swap in latency: %llu cycles average, %llu max\n",
+				swap_in_cycles / swap_in_cnt, swap_in_max);
+	if (swap_out_cnt > 0)
+		printf ("Swap out latency: %llu cycles average, %llu max\n",
+				swap_out_cycles / swap_out_cnt, swap_out_max);
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = SWAP_NONE;
+	return true;
+}
+
+/* Makes DST, which has the same contents as SRC, an anonymous
+ * page, refer to SRC's swap slot instead of its own.  DST may be
+ * a new uninit page, which becomes anonymous.  This lets a forked
+ * child share its parent's swapped-out pages without reading them
+ * in, and lets the pages that share a frame share its slot when
+ * it is evicted. */
+void
+anon_share_slot (struct page *dst, struct page *src) {
+	ASSERT (src->operations == &anon_ops);
+
+	if (VM_TYPE (dst->operations->type) == VM_UNINIT)
+		anon_initializer (dst, VM_ANON, NULL);
+	ASSERT (dst->operations == &anon_ops);
+
+	if (dst->anon.slot == src->anon.slot)
+		return;
+	if (dst->anon.slot != SWAP_NONE)
+		slot_unref (dst->anon.slot);
+	dst->anon.slot = src->anon.slot;
+	if (dst->anon.slot != SWAP_NONE)
+		slot_ref (dst->anon.slot);
+}
+
+/* Drops PAGE's swap slot, which no longer holds its contents. */
+void
+anon_forget_slot (struct page *page) {
+	ASSERT (page->operations == &anon_ops);
+
+	if (page->anon.slot != SWAP_NONE) {
+		slot_unref (page->anon.slot);
+		page->anon.slot = SWAP_NONE;
+	}
 }
 
 /* Swap in the page by read contents from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	uint64_t start = rdtsc ();
+
+	if (anon_page->slot == SWAP_NONE)
+		return false;
+
+	/* Keep the slot: it stays a valid copy until the page is
+	 * written. */
+	disk_read_multiple (swap_disk, anon_page->slot * SLOT_SECTORS,
+			SLOT_SECTORS, kva);
+	swap_in_cnt++;
+	account (start, &swap_in_cycles, &swap_in_max);
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	uint64_t start = rdtsc ();
+
+	if (anon_page->slot != SWAP_NONE) {
+		/* A clean page's slot still holds its contents. */
+		if (!pml4_is_dirty (page->owner->pml4, page->va)) {
+			swap_clean_cnt++;
+			return true;
+		}
+
+		/* Others may still need the old contents. */
+		if (slot_shared (anon_page->slot)) {
+			slot_unref (anon_page->slot);
+			anon_page->slot = SWAP_NONE;
+		}
+	}
+	if (anon_page->slot == SWAP_NONE) {
+		anon_page->slot = slot_alloc ();
+		if (anon_page->slot == SWAP_NONE)
+			return false;
+	}
+
+	disk_write_multiple (swap_disk, anon_page->slot * SLOT_SECTORS,
+			SLOT_SECTORS, page->frame->kva);
+	swap_out_cnt++;
+	account (start, &swap_out_cycles, &swap_out_max);
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->slot != SWAP_NONE)
+		slot_unref (anon_page->slot);
 }
@@ -1,9 +1,62 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Cache of `struct page's. */
+static struct kmem_cache *page_cache;
+
+/* Frame table: every frame that holds a user page and may be
+ * evicted, in the order the clock hand sweeps them.  A frame joins
+ * the table once its page is loaded and mapped, and leaves it
+ * while its page is evicted or freed. */
+static struct list frame_table;
+static struct list_elem *clock_hand;    /* Next frame to examine. */
+static struct kmem_cache *frame_cache;  /* Cache of `struct frame's. */
+
+/* Guards the frame table, the clock hand, and each frame's PAGE,
+ * PAGES, PAGE_CNT, and PIN_CNT.  Held for the whole of an eviction, so that a
+ * thread that faults on a page being evicted waits for it to be
+ * written out before reading it back in. */
+static struct lock frame_lock;
+
+/* Eviction statistics. */
+static long long evict_cnt;             /* Frames evicted. */
+static long long evict_dirty_cnt;       /* ...whose page was dirty. */
+static long long clock_step_cnt;        /* Frames the hand passed. */
+
+/* Copy-on-write statistics. */
+static long long cow_share_cnt;         /* Frames shared by fork(). */
+static long long cow_copy_cnt;          /* Write faults that copied. */
+static long long cow_reuse_cnt;         /* ...that took the frame over. */
+
+/* Fault-around and read-ahead.
+ *
+ * A fault on a page that has not been loaded yet also loads the
+ * pages after it in the same region, that is, the run of unloaded
+ * pages with the same initializer, such as the rest of an
+ * executable segment.  Each SPT follows a few streams of such
+ * faults.  A fault that lands within the window past the end of a
+ * stream's last one continues the stream and doubles its window,
+ * up to READ_AHEAD_MAX pages, so a linear scan faults less and
+ * less often.  Any other fault starts a new stream with a window
+ * of FAULT_AROUND pages.  Pages are loaded ahead only into free
+ * frames, never by evicting, and are mapped with their accessed
+ * bits clear, so that the clock reclaims unused ones first. */
+#define FAULT_AROUND 4
+#define READ_AHEAD_MAX 64
+
+/* Read-ahead statistics. */
+static long long lazy_fault_cnt;        /* Faults on unloaded pages. */
+static long long read_ahead_cnt;        /* Pages loaded ahead. */
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +68,27 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	page_cache = kmem_cache_create ("page", sizeof (struct page), 0, NULL);
+	if (page_cache == NULL)
+		PANIC ("cannot create page cache");
+	frame_cache = kmem_cache_create ("frame", sizeof (struct frame), 0, NULL);
+	if (frame_cache == NULL)
+		PANIC ("cannot create frame cache");
+	list_init (&frame_table);
+	clock_hand = list_end (&frame_table);
+	lock_init (&frame_lock);
+}
+
+/* Prints eviction statistics. */
+void
+vm_print_stats (void) {
+	printf ("Frames: %lld evicted, %lld dirty, %lld clock steps\n",
+			evict_cnt, evict_dirty_cnt, clock_step_cnt);
+	printf ("COW: %lld pages shared, %lld copied, %lld reused\n",
+			cow_share_cnt, cow_copy_cnt, cow_reuse_cnt);
+	printf ("Read-ahead: %lld faults, %lld pages loaded ahead\n",
+			lazy_fault_cnt, read_ahead_cnt);
+	swap_print_stats ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -35,6 +108,7 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_load_page (struct page *page, struct frame *frame);
 static struct frame *vm_evict_frame (void);
 
 /* Create the pending page object with initializer. If you want to create a
@@ -45,63 +119,367 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		vm_initializer *init, void *aux) {
 
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
+	ASSERT (pg_ofs (upage) == 0);
 
 	struct supplemental_page_table *spt = &thread_current ()->spt;
+	bool (*initializer) (struct page *, enum vm_type, void *);
+	struct page *page;
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+	if (spt_find_page (spt, upage) != NULL)
+		goto err;
+
+	switch (VM_TYPE (type)) {
+		case VM_ANON:
+			initializer = anon_initializer;
+			break;
+		case VM_FILE:
+			initializer = file_backed_initializer;
+			break;
+		default:
+			goto err;
+	}
 
-		/* TODO: Insert the page into the spt. */
+	page = kmem_cache_alloc (page_cache);
+	if (page == NULL)
+		goto err;
+	uninit_new (page, upage, init, type, aux, initializer);
+	page->owner = thread_current ();
+	page->writable = writable;
+
+	if (!spt_insert_page (spt, page)) {
+		kmem_cache_free (page_cache, page);
+		goto err;
 	}
+	return true;
 err:
 	return false;
 }
 
+/* Shift of the address bits that index each level of the SPT. */
+static const unsigned spt_shift[] = {PML4SHIFT, PDPESHIFT, PDXSHIFT, PTXSHIFT};
+#define SPT_LEVELS 4
+#define SPT_FANOUT 512
+
+/* Returns the leaf slot for VA in SPT, or a null pointer if
+ * there is none.  If CREATE is true, allocates missing nodes,
+ * returning a null pointer only if memory runs out. */
+static void **
+spt_walk (struct supplemental_page_table *spt, uint64_t va, bool create) {
+	uint64_t leaf_va = va & ~(HUGE_PGSIZE - 1);
+	void ***slot = &spt->root;
+	void **node;
+	int level;
+
+	if (spt->hint != NULL && spt->hint_va == leaf_va)
+		return &spt->hint[PTX (va)];
+
+	for (level = 0; ; level++) {
+		node = *slot;
+		if (node == NULL) {
+			if (!create || (node = palloc_get_page (PAL_ZERO)) == NULL)
+				return NULL;
+			*slot = node;
+			spt->node_cnt++;
+		}
+		if (level == SPT_LEVELS - 1)
+			break;
+		slot = (void ***) &node[(va >> spt_shift[level]) & (SPT_FANOUT - 1)];
+	}
+
+	spt->hint_va = leaf_va;
+	spt->hint = node;
+	return &node[PTX (va)];
+}
+
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	void **slot;
 
-	return page;
+	if (!is_user_vaddr (va))
+		return NULL;
+	slot = spt_walk (spt, (uint64_t) pg_round_down (va), false);
+	return slot != NULL ? *slot : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	void **slot;
+
+	if (pg_ofs (page->va) != 0 || !is_user_vaddr (page->va))
+		return false;
+	slot = spt_walk (spt, (uint64_t) page->va, true);
+	if (slot == NULL || *slot != NULL)
+		return false;
+	*slot = page;
+	return true;
 }
 
+/* Removes PAGE from SPT and frees it.  Empty nodes are kept until
+ * the table is killed. */
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	void **slot = spt_walk (spt, (uint64_t) page->va, false);
+
+	ASSERT (slot != NULL && *slot == page);
+	*slot = NULL;
 	vm_dealloc_page (page);
-	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Calls FUNC for each page in NODE, which is at LEVEL of the SPT
+ * and covers addresses starting at BASE, that lies in
+ * [START, END). */
+static void
+spt_walk_range (void **node, int level, uint64_t base, uint64_t start,
+		uint64_t end, spt_page_func *func, void *aux) {
+	unsigned shift = spt_shift[level];
+	unsigned i = start > base ? (start - base) >> shift : 0;
+
+	for (; i < SPT_FANOUT; i++) {
+		uint64_t child = base + ((uint64_t) i << shift);
+		void *entry = node[i];
+
+		if (child >= end)
+			break;
+		if (entry == NULL)
+			continue;
+		if (level == SPT_LEVELS - 1)
+			func (entry, aux);
+		else
+			spt_walk_range (entry, level + 1, child, start, end, func, aux);
+	}
+}
+
+/* Calls FUNC with AUX for each page in SPT whose address is in
+ * [START, END), in ascending order of address. */
+void
+spt_for_each (struct supplemental_page_table *spt, void *start, void *end,
+		spt_page_func *func, void *aux) {
+	if (spt->root != NULL)
+		spt_walk_range (spt->root, 0, 0, (uint64_t) pg_round_down (start),
+				(uint64_t) end, func, aux);
+}
+
+/* Frees NODE, at LEVEL of an SPT, and all the nodes below it. */
+static void
+spt_free_nodes (void **node, int level) {
+	int i;
+
+	if (level < SPT_LEVELS - 1)
+		for (i = 0; i < SPT_FANOUT; i++)
+			if (node[i] != NULL)
+				spt_free_nodes (node[i], level + 1);
+	palloc_free_page (node);
+}
+
+/* Adds FRAME to the frame table just behind the clock hand, so
+ * that it is examined last.  The caller must hold frame_lock. */
+static void
+frame_table_insert (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	list_insert (clock_hand, &frame->elem);
+}
+
+/* Removes FRAME from the frame table.  The caller must hold
+ * frame_lock. */
+static void
+frame_table_remove (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	list_remove (&frame->elem);
+}
+
+/* Adds PAGE to the pages mapped to FRAME.  The caller must hold
+ * frame_lock, unless no one else can see FRAME yet. */
+static void
+frame_add_page (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->share_elem);
+	frame->page_cnt++;
+	if (frame->page == NULL)
+		frame->page = page;
+	page->frame = frame;
+}
+
+/* Removes PAGE from the pages mapped to FRAME and returns the
+ * number left.  The caller must hold frame_lock. */
+static unsigned
+frame_remove_page (struct frame *frame, struct page *page) {
+	ASSERT (page->frame == frame);
+
+	list_remove (&page->share_elem);
+	page->frame = NULL;
+	frame->page = list_empty (&frame->pages) ? NULL
+		: list_entry (list_front (&frame->pages), struct page, share_elem);
+	return --frame->page_cnt;
+}
+
+/* Maps PAGE to FRAME in its owner's page table, read-only if
+ * FRAME is shared. */
+static bool
+frame_map (struct frame *frame, struct page *page) {
+	return pml4_set_page (page->owner->pml4, page->va, frame->kva,
+			page->writable && frame->page_cnt == 1);
+}
+
+/* Clears the accessed bits of FRAME's mappings.  Returns true if
+ * any of them was set. */
+static bool
+frame_clear_accessed (struct frame *frame) {
+	struct list_elem *e;
+	bool accessed = false;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, share_elem);
+
+		if (pml4_is_accessed (page->owner->pml4, page->va)) {
+			pml4_set_accessed (page->owner->pml4, page->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Returns true if any of FRAME's mappings is dirty. */
+static bool
+frame_is_dirty (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, share_elem);
+
+		if (pml4_is_dirty (page->owner->pml4, page->va))
+			return true;
+	}
+	return false;
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * Second-chance clock: the hand clears the accessed bit of each
+ * frame it passes and picks the first frame whose bit was
+ * already clear.  Evicting a dirty page costs a write, so the
+ * hand keeps going past unaccessed dirty frames for up to two
+ * turns, by which time every accessed bit has been cleared once,
+ * and settles for the first of them only if it finds no clean
+ * frame.  A shared frame counts as accessed or dirty if any of
+ * its mappings is.  Pinned frames are skipped.  Returns a null
+ * pointer if every frame is pinned or in use. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
-
-	return victim;
+	struct frame *dirty = NULL;
+	size_t cnt = list_size (&frame_table);
+	size_t i;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	for (i = 0; i < 2 * cnt; i++) {
+		struct frame *frame;
+
+		if (clock_hand == list_end (&frame_table))
+			clock_hand = list_begin (&frame_table);
+		frame = list_entry (clock_hand, struct frame, elem);
+		clock_hand = list_next (clock_hand);
+		clock_step_cnt++;
+
+		if (frame->pin_cnt > 0)
+			continue;
+		if (frame_clear_accessed (frame))
+			continue;
+		if (!frame_is_dirty (frame))
+			return frame;
+		else if (dirty == NULL)
+			dirty = frame;
+	}
+	return dirty;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+ * Return NULL on error.
+ *
+ * A shared frame is written out once, through its PAGE, and every
+ * page that shared it then shares PAGE's swap slot.  Shared frames
+ * hold only anonymous pages. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victim;
+	struct page *page;
+	struct list_elem *e;
+	bool dirty;
+
+	lock_acquire (&frame_lock);
+	victim = vm_get_victim ();
+	if (victim == NULL) {
+		lock_release (&frame_lock);
+		return NULL;
+	}
+	frame_table_remove (victim);
+	page = victim->page;
+
+	/* Unmap the pages first, so their owners cannot change them
+	 * while they are written out.  The PTEs keep their dirty bits
+	 * for swap_out(). */
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e)) {
+		struct page *p = list_entry (e, struct page, share_elem);
+		pml4_clear_page (p->owner->pml4, p->va);
+	}
+	dirty = frame_is_dirty (victim);
+	if (!swap_out (page)) {
+		/* Put the pages back as they were.  The cleared PTEs are
+		 * still there, so this cannot run out of memory. */
+		for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+				e = list_next (e)) {
+			struct page *p = list_entry (e, struct page, share_elem);
+			bool was_dirty = pml4_is_dirty (p->owner->pml4, p->va);
+
+			frame_map (victim, p);
+			pml4_set_dirty (p->owner->pml4, p->va, was_dirty);
+		}
+		frame_table_insert (victim);
+		lock_release (&frame_lock);
+		return NULL;
+	}
+	evict_cnt++;
+	if (dirty)
+		evict_dirty_cnt++;
+	while (!list_empty (&victim->pages)) {
+		struct page *p = list_entry (list_front (&victim->pages),
+				struct page, share_elem);
+
+		if (p != page)
+			anon_share_slot (p, page);
+		frame_remove_page (victim, p);
+	}
+	lock_release (&frame_lock);
+	return victim;
+}
+
+/* Returns a frame from the user pool, or a null pointer if the
+ * pool is empty. */
+static struct frame *
+vm_get_free_frame (void) {
+	struct frame *frame;
+	void *kva = palloc_get_page (PAL_USER);
+
+	if (kva == NULL)
+		return NULL;
 
-	return NULL;
+	frame = kmem_cache_alloc (frame_cache);
+	if (frame == NULL) {
+		palloc_free_page (kva);
+		return NULL;
+	}
+	frame->kva = kva;
+	frame->page = NULL;
+	list_init (&frame->pages);
+	frame->page_cnt = 0;
+	frame->pin_cnt = 0;
+	return frame;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
@@ -110,50 +488,227 @@ vm_evict_frame (void) {
  * space.*/
 static struct frame *
 vm_get_frame (void) {
-	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	struct frame *frame = vm_get_free_frame ();
 
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	if (frame == NULL)
+		frame = vm_evict_frame ();
 	return frame;
 }
 
+/* Unmaps PAGE from its owner's page table and frees its frame,
+ * if it has one and no other page shares it.  Waits for an
+ * eviction of PAGE in progress. */
+static void
+vm_free_frame (struct page *page) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (frame != NULL) {
+		if (page->owner->pml4 != NULL)
+			pml4_clear_page (page->owner->pml4, page->va);
+		if (frame_remove_page (frame, page) == 0) {
+			frame_table_remove (frame);
+			palloc_free_page (frame->kva);
+			kmem_cache_free (frame_cache, frame);
+		}
+	}
+	lock_release (&frame_lock);
+}
+
+/* Loads PAGE if necessary and pins its frame, so that it stays
+ * in memory until vm_unpin_page().  Returns false if PAGE cannot
+ * be loaded. */
+static bool
+vm_pin_page (struct page *page) {
+	for (;;) {
+		lock_acquire (&frame_lock);
+		if (page->frame != NULL) {
+			page->frame->pin_cnt++;
+			lock_release (&frame_lock);
+			return true;
+		}
+		lock_release (&frame_lock);
+		if (!vm_do_claim_page (page))
+			return false;
+	}
+}
+
+/* Lets PAGE's frame be evicted again. */
+static void
+vm_unpin_page (struct page *page) {
+	lock_acquire (&frame_lock);
+	page->frame->pin_cnt--;
+	lock_release (&frame_lock);
+}
+
 /* Growing the stack. */
 static void
 vm_stack_growth (void *addr UNUSED) {
 }
 
-/* Handle the fault on write_protected page */
+/* Returns the read-ahead stream in SPT that a fault at VA
+ * continues, with its window grown, or a new stream for it. */
+static struct spt_stream *
+read_ahead_stream (struct supplemental_page_table *spt, uint64_t va) {
+	struct spt_stream *s;
+	int i;
+
+	for (i = 0; i < SPT_STREAMS; i++) {
+		s = &spt->streams[i];
+		if (s->window > 0 && va >= s->next_va
+				&& va - s->next_va < (uint64_t) s->window * PGSIZE) {
+			if (s->window < READ_AHEAD_MAX)
+				s->window *= 2;
+			return s;
+		}
+	}
+
+	s = &spt->streams[spt->stream_next++ % SPT_STREAMS];
+	s->window = FAULT_AROUND;
+	return s;
+}
+
+/* Loads the pages after PAGE, which a fault just loaded from an
+ * uninit page with initializer INIT and type TYPE, that belong to
+ * the same region and fall in the fault's read-ahead window. */
+static void
+vm_read_ahead (struct supplemental_page_table *spt, struct page *page,
+		vm_initializer *init, enum vm_type type) {
+	struct spt_stream *s = read_ahead_stream (spt, (uint64_t) page->va);
+	uint8_t *va = page->va;
+	unsigned i;
+
+	for (i = 1; i < s->window; i++) {
+		uint8_t *next_va = va + i * PGSIZE;
+		struct page *next;
+		struct frame *frame;
+
+		if (!is_user_vaddr (next_va))
+			break;
+		next = spt_find_page (spt, next_va);
+		if (next == NULL || VM_TYPE (next->operations->type) != VM_UNINIT
+				|| next->uninit.init != init || next->uninit.type != type)
+			break;
+		frame = vm_get_free_frame ();
+		if (frame == NULL || !vm_load_page (next, frame))
+			break;
+		read_ahead_cnt++;
+	}
+	s->next_va = (uint64_t) va + i * PGSIZE;
+}
+
+/* Handle the fault on write_protected page
+ *
+ * PAGE is writable but mapped read-only because it shares its
+ * frame copy-on-write.  Gives PAGE a copy of the frame of its own,
+ * or, if the other pages have let go of the frame, just maps it
+ * writable. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_handle_wp (struct page *page) {
+	struct frame *frame, *copy;
+	bool success;
+
+	lock_acquire (&frame_lock);
+	frame = page->frame;
+	if (frame == NULL) {
+		/* Evicted since the fault.  It comes back writable. */
+		lock_release (&frame_lock);
+		return true;
+	}
+	if (frame->page_cnt == 1) {
+		pml4_clear_page (page->owner->pml4, page->va);
+		success = frame_map (frame, page);
+		cow_reuse_cnt++;
+		lock_release (&frame_lock);
+		return success;
+	}
+	frame->pin_cnt++;
+	lock_release (&frame_lock);
+
+	/* Only the current thread, PAGE's owner, can take PAGE off
+	 * FRAME, and pinning keeps FRAME in memory, so it is safe to
+	 * copy without the lock. */
+	copy = vm_get_frame ();
+	if (copy != NULL)
+		memcpy (copy->kva, frame->kva, PGSIZE);
+
+	lock_acquire (&frame_lock);
+	frame->pin_cnt--;
+	success = copy != NULL;
+	if (success) {
+		pml4_clear_page (page->owner->pml4, page->va);
+		frame_remove_page (frame, page);
+		frame_add_page (copy, page);
+		success = frame_map (copy, page);
+		frame_table_insert (copy);
+		cow_copy_cnt++;
+	}
+	lock_release (&frame_lock);
+	return success;
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr,
+		bool user UNUSED, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page;
+
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+
+	page = spt_find_page (spt, addr);
+	if (page == NULL || (write && !page->writable))
+		return false;
+
+	/* A writable page that is present but write-protected shares
+	 * its frame copy-on-write. */
+	if (!not_present)
+		return write && vm_handle_wp (page);
+
+	/* A page that still has a frame is being evicted.  Wait for
+	 * that to finish and load it back, or retry the access if the
+	 * eviction failed and put it back. */
+	if (page->frame != NULL) {
+		lock_acquire (&frame_lock);
+		lock_release (&frame_lock);
+		if (page->frame != NULL)
+			return true;
+	}
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+		vm_initializer *init = page->uninit.init;
+		enum vm_type type = page->uninit.type;
 
+		if (!vm_do_claim_page (page))
+			return false;
+		lazy_fault_cnt++;
+		vm_read_ahead (spt, page, init, type);
+		return true;
+	}
 	return vm_do_claim_page (page);
 }
 
-/* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
+/* Free the page, which must have come from page_cache.
+ *
+ * The frame goes first: vm_free_frame() waits for an eviction of
+ * PAGE in progress, which may still change PAGE's swap slot, and
+ * takes PAGE off its frame so that no later eviction sees it. */
 void
 vm_dealloc_page (struct page *page) {
+	vm_free_frame (page);
 	destroy (page);
-	free (page);
+	kmem_cache_free (page_cache, page);
 }
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = spt_find_page (&thread_current ()->spt, va);
 
+	if (page == NULL)
+		return false;
 	return vm_do_claim_page (page);
 }
 
@@ -162,29 +717,149 @@ static bool
 vm_do_claim_page (struct page *page) {
 	struct frame *frame = vm_get_frame ();
 
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	return frame != NULL && vm_load_page (page, frame);
+}
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+/* Loads PAGE into FRAME, a frame no page uses, and maps it.  Frees
+ * FRAME on failure. */
+static bool
+vm_load_page (struct page *page, struct frame *frame) {
+	/* Set links */
+	frame_add_page (frame, page);
+
+	/* Fill the frame before mapping it, so the user never sees it
+	 * half loaded. */
+	if (!swap_in (page, frame->kva)
+			|| !pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)) {
+		page->frame = NULL;
+		palloc_free_page (frame->kva);
+		kmem_cache_free (frame_cache, frame);
+		return false;
+	}
 
-	return swap_in (page, frame->kva);
+	lock_acquire (&frame_lock);
+	frame_table_insert (frame);
+	lock_release (&frame_lock);
+	return true;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->root = NULL;
+	spt->hint_va = 0;
+	spt->hint = NULL;
+	spt->node_cnt = 0;
+	memset (spt->streams, 0, sizeof spt->streams);
+	spt->stream_next = 0;
+}
+
+/* State for copy_page(). */
+struct spt_copy {
+	struct supplemental_page_table *dst;
+	bool success;
+};
+
+/* Makes DST, a new uninit page of the current thread, share the
+ * frame of SRC, a resident anonymous page, copy-on-write.  Both
+ * are mapped read-only until one of them is written. */
+static bool
+share_page (struct page *dst, struct page *src) {
+	uint64_t *pml4 = src->owner->pml4;
+	struct frame *frame;
+	bool success;
+
+	lock_acquire (&frame_lock);
+	frame = src->frame;
+
+	/* Neither page can change while they share the frame, so the
+	 * swap slot of a clean SRC stays valid for both of them.  That
+	 * of a dirty SRC is stale already. */
+	if (pml4_is_dirty (pml4, src->va))
+		anon_forget_slot (src);
+	anon_share_slot (dst, src);
+	frame_add_page (frame, dst);
+
+	pml4_clear_page (pml4, src->va);
+	success = frame_map (frame, src) && frame_map (frame, dst);
+	cow_share_cnt++;
+	lock_release (&frame_lock);
+	return success;
+}
+
+/* Copies SRC, a page of the parent, into the current thread's
+ * SPT, which is COPY_->dst.  Pages the parent has not loaded yet
+ * are loaded first, so that the child never depends on the
+ * parent's lazy-loading state.  Anonymous pages are not copied:
+ * the child shares their frames copy-on-write, or, if they are
+ * swapped out, their swap slots.  Other pages are copied, with
+ * both pages pinned. */
+static void
+copy_page (struct page *src, void *copy_) {
+	struct spt_copy *copy = copy_;
+	struct page *dst;
+
+	if (!copy->success)
+		return;
+
+	/* The parent is blocked in fork(), so no one else can bring a
+	 * swapped-out page of its back in while we look at it. */
+	if (VM_TYPE (src->operations->type) == VM_ANON && src->frame == NULL) {
+		if (!vm_alloc_page (VM_ANON, src->va, src->writable)
+				|| (dst = spt_find_page (copy->dst, src->va)) == NULL)
+			copy->success = false;
+		else
+			anon_share_slot (dst, src);
+		return;
+	}
+
+	if (!vm_pin_page (src)) {
+		copy->success = false;
+		return;
+	}
+	if (VM_TYPE (src->operations->type) == VM_ANON) {
+		if (!vm_alloc_page (VM_ANON, src->va, src->writable)
+				|| (dst = spt_find_page (copy->dst, src->va)) == NULL
+				|| !share_page (dst, src))
+			copy->success = false;
+		vm_unpin_page (src);
+		return;
+	}
+	if (!vm_alloc_page (page_get_type (src), src->va, src->writable)
+			|| (dst = spt_find_page (copy->dst, src->va)) == NULL
+			|| !vm_pin_page (dst)) {
+		vm_unpin_page (src);
+		copy->success = false;
+		return;
+	}
+	memcpy (dst->frame->kva, src->frame->kva, PGSIZE);
+	vm_unpin_page (dst);
+	vm_unpin_page (src);
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct spt_copy copy = {dst, true};
+
+	ASSERT (dst == &thread_current ()->spt);
+	spt_for_each (src, NULL, (void *) KERN_BASE, copy_page, &copy);
+	return copy.success;
+}
+
+/* Frees PAGE for supplemental_page_table_kill(). */
+static void
+kill_page (struct page *page, void *aux UNUSED) {
+	vm_dealloc_page (page);
 }
 
 /* Free the resource hold by the supplemental page table */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	spt_for_each (spt, NULL, (void *) KERN_BASE, kill_page, NULL);
+	if (spt->root != NULL)
+		spt_free_nodes (spt->root, 0);
+	supplemental_page_table_init (spt);
 }